@@ -240,6 +240,16 @@ namespace tchess
 		return false;
 	}
 
+	bool chessboard::hasNonPawnMaterial(unsigned int side) const {
+		for(int square = 0; square < 64; ++square) {
+			int piece = OWN_SIDE(side, squares[square]); //own pieces are positive this way
+			if(piece > 1 && piece != 5) { //using 1 and 5 instead of 'pawn', 'king' const to eliminate warning
+				return true;
+			}
+		}
+		return false;
+	}
+
 	std::string chessboard::to_string() const {
 		std::string bS = "---------------------------\n";
 		for(int i=0; i<8; ++i) { //add each rank
@@ -274,6 +284,7 @@ namespace tchess
 		enPassantCaptureSquares[white] = noEnPassant;
 		enPassantCaptureSquares[black] = noEnPassant;
 		sideToMove = white; //white begins
+		halfmoveClock = 0;
 	}
 
 	void game_information::disableKingsideCastleRight(unsigned int side) {
@@ -322,10 +333,26 @@ namespace tchess
 			//square behin pawn is a possible en passant square for the ENEMY side
 			info.setEnPassantSquare(enemySide, squareBehindPawn);
 		}
+		//captures and pawn moves are irreversible (the pawn already stands on the destination square)
+		int movedPiece = board[m.getToSquare()];
+		if(m.isCapture() || m.isPromotion() || movedPiece == 1 || movedPiece == -1) {
+			info.setHalfmoveClock(0);
+		} else {
+			info.setHalfmoveClock(info.getHalfmoveClock() + 1);
+		}
 
 		info.setSideToMove(enemySide); //update side to move
 	}
 
+	void updateGameInformationNullMove(game_information& info) {
+		int sideThatMoved = info.getSideToMove(); //not updated yet
+		//en passant squares expire, just like after a real move
+		info.setEnPassantSquare(sideThatMoved, noEnPassant);
+		info.setEnPassantSquare(1-sideThatMoved, noEnPassant);
+		info.setHalfmoveClock(1); //only the position of the null move counts for repetitions, not the ones before it
+		info.setSideToMove(1-sideThatMoved); //pass the turn
+	}
+
 	//name / number conversion methods
 
 	std::string createSquareName(int square) {
@@ -583,6 +610,56 @@ namespace tchess
 		generatePseudoLegalCastleMoves(side, moves); //add castling moves
 	}
 
+	bool move_generator::isPseudoLegalMove(unsigned int side, const move& m) const {
+		const unsigned int from = m.getFromSquare(), to = m.getToSquare();
+		if(from > 63 || to > 63 || from == to || m.isResign()) return false;
+		const int piece = OWN_SIDE(side, board[from]); //own pieces are positive this way
+		if(piece <= 0) return false; //no piece of the side on the departure square
+		if(m.isKingsideCastle() || m.isQueensideCastle()) { //same conditions as in the castle move generation
+			std::vector<move> castleMoves;
+			generatePseudoLegalCastleMoves(side, castleMoves);
+			for(const move& castleMove: castleMoves) {
+				if(castleMove == m) return true;
+			}
+			return false;
+		}
+		const int target = OWN_SIDE(side, board[to]); //positive if own piece, negative if enemy piece
+		if(target > 0) return false; //can't move to a square of an own piece
+		if(m.isCapture() && !m.isEnPassant() && target == 0) return false; //capture flag, but nothing to capture
+		if(!m.isCapture() && target < 0) return false; //capture without the flag
+		const int fromFile = from % 8, toFile = to % 8;
+		if(piece == 1) { //pawn moves, using 1 instead of 'pawn' const to eliminate warning
+			const int forward = side == white ? -8 : 8;
+			const int diff = (int)to - (int)from;
+			const bool toLastRank = side == white ? to / 8 == 0 : to / 8 == 7;
+			if(m.isPromotion() != toLastRank) return false; //pawn moves to the last rank must be promotions, and the other way
+			if(m.isDoublePawnPush()) {
+				const unsigned int startRank = side == white ? 6 : 1;
+				return from / 8 == startRank && diff == 2*forward && board[from+forward] == empty && target == 0;
+			}
+			if(!m.isCapture()) { //single push, or quiet promotion
+				return diff == forward && target == 0;
+			}
+			//captures go diagonally forward
+			if(std::abs(fromFile - toFile) != 1 || (diff != forward-1 && diff != forward+1)) return false;
+			if(m.isEnPassant()) {
+				return target == 0 && to == gameInfo.getEnPassantSquare(side);
+			}
+			return true; //normal and promotion captures, the target was already checked
+		}
+		//non pawn pieces can only make normal moves and captures
+		if(m.isPromotion() || m.isDoublePawnPush() || m.isEnPassant()) return false;
+		for(unsigned int i=0; i<offsetAmount[piece]; ++i) { //walk in all directions of the piece until the destination is found
+			for (int n = from;;) {
+				n = mailbox[mailbox64[n] + offsets[piece][i]];
+				if(n == -1) break; //off the board
+				if(n == (int)to) return true;
+				if(board[n] != empty || !canSlide[piece]) break; //blocked, or not a sliding piece
+			}
+		}
+		return false;
+	}
+
 	static const int pawnAttackOffsets[2][2] = {
 			{9, 11}, // <-- for white
 			{-9, -11} // <-- for black
@@ -654,6 +731,149 @@ namespace tchess
 		return attacked;
 	}
 
+	void attackersTo(const chessboard& board, unsigned int square, square_attackers& attackers, int ignoredSquare) {
+		attackers.knightCount = 0;
+		for(unsigned int i=0; i<offsetAmount[knight]; ++i) { //knights can't be blocked or x-rayed
+			int n = mailbox[mailbox64[square] + offsets[knight][i]];
+			if(n != -1 && n != ignoredSquare && (board[n] == 2 || board[n] == -2)) { //using 2 instead of 'knight' const to eliminate warning
+				attackers.knights[attackers.knightCount++] = n;
+			}
+		}
+		for(unsigned int i=0; i<offsetAmount[queen]; ++i) { //walk all lines (queen directions) going out from the square
+			const int direction = offsets[queen][i];
+			const bool diagonal = direction == -11 || direction == -9 || direction == 9 || direction == 11;
+			unsigned int distance = 0, length = 0;
+			for (int n = square;;) {
+				n = mailbox[mailbox64[n] + direction];
+				if(n == -1) break; //off the board
+				++distance;
+				if(board[n] == empty || n == ignoredSquare) continue;
+				const unsigned int attackerSide = board[n] > 0 ? white : black;
+				const unsigned int piece = board[n] > 0 ? board[n] : -board[n];
+				bool attacks;
+				if(piece == pawn) { //only on the 2 diagonals the pawn attacks on, and only from distance 1
+					attacks = distance == 1 && (direction == pawnAttackOffsets[attackerSide][0] || direction == pawnAttackOffsets[attackerSide][1]);
+				} else if(piece == king) {
+					attacks = distance == 1;
+				} else if(piece == queen) {
+					attacks = true;
+				} else if(piece == bishop) {
+					attacks = diagonal;
+				} else if(piece == rook) {
+					attacks = !diagonal;
+				} else { //knight, it blocks the line
+					attacks = false;
+				}
+				if(!attacks) break; //this piece blocks everything behind it
+				attackers.lines[i][length++] = n;
+			}
+			attackers.lineLength[i] = length;
+		}
+	}
+
+	/*
+	 * Precomputed relations of square pairs, used to find checks. Line directions are the queen offsets
+	 * leading from the first square to the second, 0 if they are not on a common line.
+	 */
+	static int lineDirection[64][64];
+
+	//True if a knight on the first square attacks the second.
+	static bool knightReach[64][64];
+
+	static bool initSquareRelations() {
+		for(int from = 0; from < 64; ++from) {
+			for(int to = 0; to < 64; ++to) {
+				lineDirection[from][to] = 0;
+				knightReach[from][to] = false;
+			}
+			for(unsigned int i=0; i<offsetAmount[queen]; ++i) {
+				for(int n = mailbox[mailbox64[from] + offsets[queen][i]]; n != -1; n = mailbox[mailbox64[n] + offsets[queen][i]]) {
+					lineDirection[from][n] = offsets[queen][i];
+				}
+			}
+			for(unsigned int i=0; i<offsetAmount[knight]; ++i) {
+				int n = mailbox[mailbox64[from] + offsets[knight][i]];
+				if(n != -1) knightReach[from][n] = true;
+			}
+		}
+		return true;
+	}
+
+	static const bool squareRelationsInitialized = initSquareRelations();
+
+	//Checks if the piece (code without side) slides in the direction.
+	static inline bool slidesInDirection(unsigned int piece, int direction) {
+		if(!canSlide[piece]) return false;
+		for(unsigned int k = 0; k<offsetAmount[piece]; ++k) {
+			if(offsets[piece][k] == direction) return true;
+		}
+		return false;
+	}
+
+	/*
+	 * The squares changed by a move: the emptied squares are treated as empty and the filled ones
+	 * as occupied, so lines can be checked as if the move was made. Unused slots are -1.
+	 */
+	struct changed_squares {
+		int emptied[2];
+		int filled[2];
+
+		inline bool isOccupied(const chessboard& board, int square) const {
+			if(square == filled[0] || square == filled[1]) return true;
+			return board[square] != empty && square != emptied[0] && square != emptied[1];
+		}
+	};
+
+	//Returns the first occupied square from the square in the direction, or -1 if there is none.
+	static int firstOccupied(const chessboard& board, const changed_squares& changed, unsigned int square, int direction) {
+		for(int n = mailbox[mailbox64[square] + direction]; n != -1; n = mailbox[mailbox64[n] + direction]) {
+			if(changed.isOccupied(board, n)) return n;
+		}
+		return -1;
+	}
+
+	bool givesCheck(const chessboard& board, const move& m, unsigned int side) {
+		const unsigned int enemyKing = board.getKingSquare(1-side);
+		const int from = m.getFromSquare(), to = m.getToSquare();
+		int checker = to; //square of the piece that may give direct check
+		unsigned int checkerPiece = board[from] > 0 ? board[from] : -board[from];
+		changed_squares changed = {{from, -1}, {to, -1}};
+		if(m.isKingsideCastle() || m.isQueensideCastle()) { //the rook may give check, from next to the king
+			int rookFrom = m.isKingsideCastle() ? to + 1 : to - 2;
+			checker = m.isKingsideCastle() ? from + 1 : from - 1;
+			checkerPiece = rook;
+			changed = {{from, rookFrom}, {to, checker}};
+		} else if(m.isEnPassant()) {
+			changed.emptied[1] = side == white ? to + 8 : to - 8; //the captured pawn
+		} else if(m.isPromotion()) {
+			checkerPiece = m.promotedTo();
+		}
+		//direct check
+		if(checkerPiece == pawn) {
+			for(unsigned int i=0; i<2; ++i) {
+				if(mailbox[mailbox64[enemyKing] + pawnAttackOffsets[side][i]] == checker) return true;
+			}
+		} else if(checkerPiece == knight) {
+			if(knightReach[checker][enemyKing]) return true;
+		} else {
+			int direction = lineDirection[enemyKing][checker];
+			if(direction != 0 && slidesInDirection(checkerPiece, direction)
+					&& firstOccupied(board, changed, enemyKing, direction) == checker) return true;
+		}
+		//discovered check: an emptied square opens a line from the king to an own sliding piece
+		for(unsigned int i=0; i<2; ++i) {
+			if(changed.emptied[i] == -1) continue;
+			int direction = lineDirection[enemyKing][changed.emptied[i]];
+			if(direction == 0) continue;
+			int n = firstOccupied(board, changed, enemyKing, direction);
+			if(n == -1 || n == changed.filled[0] || n == changed.filled[1]) continue; //moved pieces are checked above
+			unsigned int piece = board[n] > 0 ? board[n] : -board[n];
+			bool ownPiece = side == white ? board[n] > 0 : board[n] < 0;
+			if(ownPiece && slidesInDirection(piece, direction)) return true;
+		}
+		return false;
+	}
+
 	bool isLegalMove(const move& playerMove, chessboard& board, const game_information& info) {
 		bool legal = false;
 		unsigned int side = info.getSideToMove();
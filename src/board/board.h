@@ -148,6 +148,12 @@ namespace tchess
 		 */
 		bool isInsufficientMaterial() const;
 
+		/*
+		 * Checks if the side has any pieces other than pawns and the king. Positions
+		 * where this is false are prone to zugzwang.
+		 */
+		bool hasNonPawnMaterial(unsigned int side) const;
+
 		/*
 		 * Mostly a debug method that will create a string representation of the board that can
 		 * be printed to see if the move making/unmaking was correct. It uses the letters of each
@@ -212,6 +218,12 @@ namespace tchess
 		 */
 		int enPassantCaptureSquares[2];
 
+		/*
+		 * Amount of half moves (plies) since the last capture or pawn move. Used for the fifty-move rule,
+		 * and positions that occurred before this many half moves can't be repeated anymore.
+		 */
+		unsigned int halfmoveClock;
+
 	public:
 
 		/**
@@ -285,6 +297,20 @@ namespace tchess
 		inline unsigned int getSideToMove() const {
 			return sideToMove;
 		}
+
+		/*
+		 * Getter for the halfmove clock.
+		 */
+		inline unsigned int getHalfmoveClock() const {
+			return halfmoveClock;
+		}
+
+		/*
+		 * Update the halfmove clock. It's 0 after an irreversible move, and increases by 1 after a reversible one.
+		 */
+		inline void setHalfmoveClock(unsigned int clock) {
+			halfmoveClock = clock;
+		}
 	};
 
 	/*
@@ -294,9 +320,23 @@ namespace tchess
 	 *  - Update side to move to the next side.
 	 *  - Update castling rights.
 	 *  - Update en passant attack squares.
+	 *  - Update the halfmove clock.
 	 */
 	void updateGameInformation(const chessboard& board, const move& m, game_information& info);
 
+	/*
+	 * Modifies the 'info' object as if the side to move passed its turn (null move). The
+	 * board is not changed by a null move, so there is nothing to make or unmake there, and
+	 * the info object is copy made, so it can be restored by keeping the original.
+	 * Includes:
+	 *  - Update side to move to the next side.
+	 *  - Remove en passant squares, since they expire after any move.
+	 *  - Set the halfmove clock to 1: of the positions before the null move, only the one where it was made
+	 *    can be repeated in the search below it.
+	 * The hash key of the position changes accordingly, as it is created from the info object.
+	 */
+	void updateGameInformationNullMove(game_information& info);
+
 	/*
 	 * This class creates moves from a chessboard and the side to move.
 	 */
@@ -327,6 +367,13 @@ namespace tchess
 		 */
 		void generatePseudoLegalMoves(unsigned int side, std::vector<move>&) const;
 
+		/*
+		 * Checks if a move is pseudo legal for the side, without generating all the moves. The flags
+		 * of the move must also be correct, so a move from an unreliable source (such as the transposition table, where
+		 * keys may collide) can be verified before making it on the board.
+		 */
+		bool isPseudoLegalMove(unsigned int side, const move& m) const;
+
 	private:
 
 		/*
@@ -358,6 +405,40 @@ namespace tchess
 	 */
 	bool isAttacked(const chessboard& board, unsigned int attackingSide, unsigned int square);
 
+	/*
+	 * The pieces of both sides that attack a square. Knights are stored separately, every other
+	 * attacker is on one of the 8 lines going out from the square. Pieces on a line are ordered
+	 * by distance, and only the first can attack directly: the ones behind it are x-ray attackers,
+	 * they attack only after the pieces in front of them captured on the square.
+	 */
+	struct square_attackers {
+
+		//Squares of the attackers on each line, the closest first.
+		unsigned int lines[8][7];
+
+		//Amount of attackers on each line.
+		unsigned int lineLength[8];
+
+		//Squares of the attacking knights.
+		unsigned int knights[8];
+
+		//Amount of attacking knights.
+		unsigned int knightCount;
+	};
+
+	/*
+	 * Collects the attackers (including x-ray attackers) of the square from both sides. The ignored
+	 * square is treated as empty, for example the departure square of a piece that moves to the square.
+	 */
+	void attackersTo(const chessboard& board, unsigned int square, square_attackers& attackers, int ignoredSquare = -1);
+
+	/*
+	 * Checks if a pseudo legal move of the side gives check to the enemy king, without making the move.
+	 * Handles direct checks (also by the promoted piece and the castling rook), discovered checks (also
+	 * by the removal of the pawn captured en passant).
+	 */
+	bool givesCheck(const chessboard& board, const move& m, unsigned int side);
+
 	/**
 	 * This method checks if a move is legal. It will take into consideration the board and
 	 * the game_information object. It is assumed that the move is at least PSEUDO LEGAL!!!
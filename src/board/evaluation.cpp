@@ -180,6 +180,92 @@ namespace tchess
 	const int WORST_VALUE = INT32_MIN + 100;
 	const int BEST_VALUE = INT32_MAX - 100;
 
+	//Mates are never found further than this many plies from the root.
+	static const int maxMateDistance = 1000;
+
+	bool isMateScore(int evaluation) {
+		return evaluation <= WORST_VALUE + maxMateDistance || evaluation >= -(WORST_VALUE + maxMateDistance);
+	}
+
+	/*
+	 * Finds the least valuable piece of the side that can capture on the square in the current
+	 * state of the exchange, and removes it from the attackers. Returns -1 if the side has no
+	 * more attackers. Only the first piece of every line can capture, the pieces behind it are x-rays.
+	 */
+	static int popLeastValuableAttacker(const chessboard& board, unsigned int side, square_attackers& attackers,
+			unsigned int lineStart[8]) {
+		int bestValue = INT32_MAX, bestSquare = -1, bestLine = -1; //line -1 means knight
+		unsigned int bestKnight = 0;
+		for(unsigned int i=0; i<attackers.knightCount; ++i) {
+			const int square = attackers.knights[i];
+			if((board[square] > 0) == (side == white) && pieceValues[knight] < bestValue) {
+				bestValue = pieceValues[knight];
+				bestSquare = square;
+				bestKnight = i;
+			}
+		}
+		for(unsigned int line=0; line<8; ++line) {
+			if(lineStart[line] == attackers.lineLength[line]) continue; //this line is used up
+			const int square = attackers.lines[line][lineStart[line]];
+			if((board[square] > 0) != (side == white)) continue; //enemy piece in front, blocks the line for this side
+			const int value = pieceValues[board[square] > 0 ? board[square] : -board[square]];
+			if(value < bestValue) {
+				bestValue = value;
+				bestSquare = square;
+				bestLine = line;
+			}
+		}
+		if(bestSquare == -1) return -1;
+		if(bestLine == -1) { //remove the knight by moving the last one into its place
+			attackers.knights[bestKnight] = attackers.knights[--attackers.knightCount];
+		} else { //the next piece on this line is no longer x-raying
+			++lineStart[bestLine];
+		}
+		return bestValue;
+	}
+
+	int staticExchangeEvaluation(const chessboard& board, const move& m) {
+		const unsigned int from = m.getFromSquare(), to = m.getToSquare();
+		unsigned int side = board[from] > 0 ? white : black;
+		//the piece that stands on the destination square after the move
+		int pieceOnSquare = pieceValues[board[from] > 0 ? board[from] : -board[from]];
+		int gain[32];
+		unsigned int d = 0;
+		if(m.isEnPassant()) {
+			gain[0] = pieceValues[pawn];
+		} else {
+			gain[0] = pieceValues[board[to] > 0 ? board[to] : -board[to]];
+		}
+		if(m.isPromotion()) {
+			pieceOnSquare = pieceValues[m.promotedTo()];
+			gain[0] += pieceOnSquare - pieceValues[pawn];
+		}
+		square_attackers attackers;
+		attackersTo(board, to, attackers, from); //the moving piece already left its square
+		unsigned int lineStart[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+		/*
+		 * gain[d] is the material balance from the view of the side making the d-th capture, if
+		 * the exchange stops after it. Speculatively stored before it's known that the capture can happen.
+		 */
+		while(d < 31) {
+			side = 1 - side;
+			++d;
+			gain[d] = pieceOnSquare - gain[d-1];
+			const int attackerValue = popLeastValuableAttacker(board, side, attackers, lineStart);
+			if(attackerValue == -1) break; //no capture, the last speculative gain is ignored
+			pieceOnSquare = attackerValue;
+		}
+		//every side can decide to stop capturing, so propagate the best choices back to the first move
+		while(--d) {
+			gain[d-1] = -std::max(-gain[d-1], gain[d]);
+		}
+		return gain[0];
+	}
+
+	bool staticExchangeEvaluation(const chessboard& board, const move& m, int threshold) {
+		return staticExchangeEvaluation(board, m) >= threshold;
+	}
+
 	/*
 	 * Checks if the position is special in a way that it does not need to be evaluated. For example
 	 * mates and insufficient material.
@@ -191,7 +277,7 @@ namespace tchess
 		if(!legalMoves) {
 			bool inCheck = isAttacked(board, 1-side, board.getKingSquare(side));
 			if(inCheck) {
-				return {true, WORST_VALUE - depth};
+				return {true, WORST_VALUE + depth}; //mates closer to the root are worse
 			} else {
 				return {true, 0};
 			}
@@ -226,6 +312,7 @@ namespace tchess
 			int direction = offsets[bishop][i];
 			for (int n = square;;) {
 				n = mailbox[mailbox64[n] + direction]; //next square in this direction
+				if(n == -1) break; //bishop is on the edge of the board
 				if(board[n] == 1 || board[n] == -1) { //a pawn found
 					++pawnsAround;
 				}
@@ -45,6 +45,12 @@ namespace tchess
 	 */
 	extern const int BEST_VALUE;
 
+	/*
+	 * Checks if the evaluation means a forced mate for either side. Mate scores depend
+	 * on the distance from the root, so they must not be returned without proof.
+	 */
+	bool isMateScore(int evaluation);
+
 	/*
 	 * Checks if the position is special in a way that it does not need to be evaluated. For example
 	 * mates and insufficient material. Legal moves parameter is true when there are still legal moves
@@ -94,6 +100,23 @@ namespace tchess
 	 */
 	int kingSafetyEvaluation(unsigned int side, unsigned int square, const chessboard& board);
 
+	/*
+	 * Static exchange evaluation: the material balance (from the view of the moving side) of the
+	 * capture sequence started by the move on its destination square, if both sides always recapture
+	 * with their least valuable attacker and stop when recapturing would lose material. X-ray attackers
+	 * join the exchange when the pieces in front of them have captured. Pins are ignored.
+	 *
+	 * Must be called before the move is made on the board. Works for quiet moves too: then it tells
+	 * if the moved piece can be won on its new square.
+	 */
+	int staticExchangeEvaluation(const chessboard& board, const move& m);
+
+	/*
+	 * Checks if the static exchange evaluation of the move is at least the threshold. For example
+	 * with threshold 0 it tells if the move does not lose material.
+	 */
+	bool staticExchangeEvaluation(const chessboard& board, const move& m, int threshold);
+
 	/*
 	 * Main static evaluator function. Used in negamax, so it evaluates relative to the side to move.
 	 *
@@ -119,6 +119,14 @@ namespace tchess
 		return *this;
 	}
 
+	unsigned short move::pack() const {
+		return (unsigned short)(fromSquare | (toSquare << 6) | (flags.to_ulong() << 12));
+	}
+
+	move unpackMove(unsigned short packed) {
+		return move(packed & 63, (packed >> 6) & 63, packed >> 12, 0);
+	}
+
 	//Helper method to convert piece codes into letters
 	char pieceNameFromCode(int pieceCode) {
 		switch(pieceCode) {
@@ -229,6 +229,12 @@ namespace tchess
 
 		inline unsigned int getScore() const { return score; }
 
+		/*
+		 * Move ordering may change the score given by the move generator, for example
+		 * to rank quiet moves.
+		 */
+		inline void setScore(unsigned int newScore) { score = newScore; }
+
 		/*
 		 * Equality check between 2 moves. They are equal if both the departure
 		 * and the destination squares are equal. In case of promotions, the equality
@@ -246,8 +252,19 @@ namespace tchess
 		 * object does not store what piece moved that must be passed in
 		 */
 		std::string to_string(int pieceThatMoved) const;
+
+		/*
+		 * Packs the move into 16 bits: departure square, destination square and flags on 6, 6 and 4 bits.
+		 * The score is not stored. NULLMOVE is packed into 0.
+		 */
+		unsigned short pack() const;
 	};
 
+	/*
+	 * Creates a move from its packed form, see move::pack. The score will be 0.
+	 */
+	move unpackMove(unsigned short packed);
+
 	/*
 	 * Move from square 0 to 0, can be used to indicate that no move was found/no move exists.
 	 */
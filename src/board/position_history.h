@@ -0,0 +1,61 @@
+/*
+ * position_history.h
+ */
+
+#ifndef SRC_BOARD_POSITION_HISTORY_H_
+#define SRC_BOARD_POSITION_HISTORY_H_
+
+#include <vector>
+
+namespace tchess
+{
+	/*
+	 * Stores the hash keys of the positions that occurred so far, to detect repetitions. The game
+	 * pushes the key of every position, and the engine takes a copy of this before searching, then pushes
+	 * and pops the keys of the positions on the current search path.
+	 */
+	class position_history {
+
+		//Keys in the order the positions occurred, the last one is the latest position.
+		std::vector<unsigned long long> keys;
+
+	public:
+		/*
+		 * Adds the key of a new position.
+		 */
+		void push(unsigned long long key) {
+			keys.push_back(key);
+		}
+
+		/*
+		 * Removes the key of the latest position.
+		 */
+		void pop() {
+			keys.pop_back();
+		}
+
+		/*
+		 * Forgets all positions.
+		 */
+		void clear() {
+			keys.clear();
+		}
+
+		/*
+		 * Checks if the position with the key (which follows the latest stored position) occurred at least
+		 * 'times' times before. Only the positions since the last irreversible move can be the same, and only
+		 * every second one of those, where the same side was to move.
+		 * - halfmove clock: the halfmove clock of the checked position.
+		 */
+		bool isRepeated(unsigned long long key, unsigned int halfmoveClock, unsigned int times) const {
+			unsigned int found = 0;
+			//the same position can come back after 4 half moves at the earliest
+			for(unsigned int distance = 4; distance <= halfmoveClock && distance <= keys.size(); distance += 2) {
+				if(keys[keys.size() - distance] == key && ++found >= times) return true;
+			}
+			return false;
+		}
+	};
+}
+
+#endif /* SRC_BOARD_POSITION_HISTORY_H_ */
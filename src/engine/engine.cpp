@@ -9,6 +9,14 @@
 #include <limits>
 #include <algorithm>
 #include <cstring>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <set>
+#include <mutex>
+#include <iterator>
+#include <iostream>
+#include <stdexcept>
 
 #include "engine.h"
 #include "board/evaluation.h"
@@ -24,151 +32,350 @@ namespace tchess
 		move_generator generator(board, info);
 		generator.generatePseudoLegalMoves(side, moves);
 		auto legalCheck = [&](const move& m) { return !(isLegalMove(m, board, info)); };
-		auto legalEnd = std::remove_if(moves.begin(), moves.end(), legalCheck);
-		//order moves
-		std::sort(moves.begin(), moves.end(), std::greater<move>());
-		//we cant be at maximum depth, since this is the root call
+		moves.erase(std::remove_if(moves.begin(), moves.end(), legalCheck), moves.end());
+		if(moves.empty()) { //mate or stalemate, there is nothing to search
+			statistics.clear();
+			previousPv.clear();
+			control.stop = false;
+			return NULLMOVE;
+		}
+		worker.setPosition(board, info, history);
+		worker.newSearch();
+		ttable->newSearch();
+		statistics.clear();
+		previousPv.clear();
+		control.nodes = 0;
+		auto searchStart = std::chrono::steady_clock::now();
+		if(options.timeLimit > 0 && !control.pondering) {
+			control.deadline = (searchStart + std::chrono::milliseconds(options.timeLimit)).time_since_epoch().count();
+		}
+		uint64 rootKey = createZobrishHash(board, info);
 		move bestMove;
-		int bestEvaluation = WORST_VALUE;
-		int count = 0;
-		for(auto it = moves.begin(); it != legalEnd; it++) { //iterate legal moves
-			move& _move = *it;
-			int p = std::abs(board[_move.getFromSquare()]);
-			//this is not working in eclipse console but does in normal console!
-			std::cout << "\rAnalyzing " << ++count << ". move out of " << moves.size()
-								<< ", move: " << _move.to_string(p) << "           "; //<- to delete whole line
-			int capturedPiece = board.makeMove(_move, side);
-			game_information infoAfterMove = info; //create a game info object
-			updateGameInformation(board, _move, infoAfterMove); //update new info object with move
-			int evaluation = -alphaBetaNegamax(WORST_VALUE, BEST_VALUE, depth-1, infoAfterMove); //move down in the tree
-			board.unmakeMove(_move, side, capturedPiece); //unmake the move before moving on
-			if(evaluation >= bestEvaluation) {
-				bestEvaluation = evaluation;
-				bestMove = _move;
+		for(unsigned int iterationDepth = 1; iterationDepth <= depth; ++iterationDepth) { //iterative deepening
+			//order moves: the best move of the previous iteration (or an earlier search) first
+			move firstMove = NULLMOVE;
+			if(!previousPv.empty()) {
+				firstMove = previousPv[0];
+			} else {
+				transposition_entry rootEntry;
+				if(ttable->find(rootKey, rootEntry, 0)) firstMove = rootEntry.bestMove;
+			}
+			worker.orderRootMoves(moves, firstMove);
+			worker.setPreviousPv(previousPv);
+			unsigned long long nodesBeforeIteration = worker.getStatistics().nodes;
+			auto iterationStart = std::chrono::steady_clock::now();
+			move iterationBestMove;
+			std::vector<move> iterationPv;
+			int alpha = WORST_VALUE;
+			int count = 0;
+			for(auto it = moves.begin(); it != moves.end(); it++) { //iterate legal moves
+				move& _move = *it;
+				int p = std::abs(board[_move.getFromSquare()]);
+				++count;
+				//this is not working in eclipse console but does in normal console!
+				if(!control.pondering) std::cout << "\rAnalyzing " << count << ". move out of " << moves.size()
+									<< ", move: " << _move.to_string(p) << "           "; //<- to delete whole line
+				int evaluation;
+				if(it == moves.begin()) { //the expected best move is searched with full window
+					evaluation = worker.searchRootMove(_move, alpha, BEST_VALUE, iterationDepth);
+				} else { //the others only need to be proven worse, unless they are better
+					evaluation = worker.searchRootMove(_move, alpha, alpha+1, iterationDepth);
+					if(evaluation > alpha) {
+						evaluation = worker.searchRootMove(_move, alpha, BEST_VALUE, iterationDepth);
+					}
+				}
+				if(control.stop) break; //the evaluation is not reliable
+				if(it == moves.begin() || evaluation > alpha) {
+					alpha = evaluation;
+					iterationBestMove = _move;
+					iterationPv = worker.getLine();
+				}
+			}
+			if(control.stop) { //only completed iterations are used, unless this was the first
+				if(bestMove == NULLMOVE) bestMove = iterationBestMove == NULLMOVE ? moves[0] : iterationBestMove;
+				if(!control.pondering) std::cout << std::endl; //end the progress line
+				break;
+			}
+			bestMove = iterationBestMove;
+			previousPv = iterationPv;
+			unsigned long long nodes = worker.getStatistics().nodes;
+			auto iterationEnd = std::chrono::steady_clock::now();
+			double seconds = std::chrono::duration<double>(iterationEnd - searchStart).count();
+			statistics.iterations.push_back(iteration_statistics(iterationDepth, nodes - nodesBeforeIteration,
+					std::chrono::duration<double>(iterationEnd - iterationStart).count(), alpha));
+			if(!control.pondering) {
+				std::cout << "\r";
+				printPrincipalVariation(board, info, previousPv, iterationDepth, alpha, nodes, seconds);
 			}
 		}
-		std::cout << std::endl;
-		ttable->invalidateEntries();
+		statistics.merge(worker.getStatistics());
+		statistics.ttOccupancy = ttable->occupancy();
+		statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - searchStart).count();
+		control.stop = false;
+		control.deadline = 0;
 		//ttable->printDebug();
-		printPrincipalVariation(board, info, depth);
 		return bestMove;
 	}
 
-	//Helper struct that stores if a move was checked to be legal, and what is the result of the check.
-	struct legality_checked {
-		bool checked;
-		bool legal;
-		legality_checked() : checked(false), legal(false) {}
-	};
-
-	int engine::alphaBetaNegamax(int alpha, int beta, unsigned int depthLeft, game_information& gameInfo) {
-		unsigned int side = gameInfo.getSideToMove();
-		int alphaOriginal = alpha;
-		//look up position in transposition table
-		uint64 zobristKey = createZobrishHash(board, gameInfo);
-		transposition_entry& entry = ttable->find(zobristKey);
-		if(entry != EMPTY_ENTRY && zobristKey == entry.hashKey && entry.depth >= depthLeft) {
-			//found in transposition table
-			entry.usefulEntry = true; //mark this as useful
-			if(entry.entryType == exact) { //exact match
-				return entry.score;
-			} else if(entry.entryType == lowerBound) {
-				alpha = std::max(alpha, entry.score);
-			} else if(entry.entryType == upperBound) {
-				beta = std::min(beta, entry.score);
-			}
-			if(alpha >= beta) return entry.score;
-		}
-		//create pseudo legal moves for this board and side
+	std::vector<root_move_result> engine::analyze(const chessboard& position, const game_information& positionInfo, unsigned int multiPv) {
+		multiPv = std::max(multiPv, 1u);
+		unsigned int side = positionInfo.getSideToMove();
+		chessboard rootBoard = position;
 		std::vector<move> moves;
-		move_generator generator(board, gameInfo);
+		move_generator generator(rootBoard, positionInfo);
 		generator.generatePseudoLegalMoves(side, moves);
-		//SORT moves indo descending order based on their move scores (move ordering)
-		std::sort(moves.begin(), moves.end(), std::greater<move>());
-		//this lambda is used to see which moves are legal
-		legality_checked legalityChecks[moves.size()];
-		bool legalMovesExist = false; //stores if any legal move was found
-		for(unsigned int i = 0; i<moves.size(); ++i) { //start checking moves for legality, but only until one legal is found
-			if(isLegalMove(moves[i], board, gameInfo)) {
-				legalityChecks[i].checked = true; //store that this move was already checked
-				legalityChecks[i].legal = true;
-				legalMovesExist = true;
-				break; //dont check anymore moves
-			} else {
-				legalityChecks[i].checked = true; //store that this move was already checked
-				legalityChecks[i].legal = false;
-			}
+		auto legalCheck = [&](const move& m) { return !(isLegalMove(m, rootBoard, positionInfo)); };
+		moves.erase(std::remove_if(moves.begin(), moves.end(), legalCheck), moves.end());
+		//workers: the one of the engine, and the helpers for the other threads
+		unsigned int threads = std::max(options.threads, 1u);
+		while(helpers.size() < threads - 1) {
+			helpers.push_back(new search_worker(options, *ttable, control));
 		}
-		if(depthLeft == 0) { //we are at maximum search depth, evaluate
-			special_board sb = isSpecialBoard(side, board, legalMovesExist, depth - depthLeft); //detect mates and drawn games
-			if(sb.special) {
-				return sb.evaluation; //return special evaluation
-			} else {
-				return evaluateBoard(side, board, gameInfo, moves.size()); //evaulate non special board
-			}
+		std::vector<search_worker*> workers = { &worker };
+		workers.insert(workers.end(), helpers.begin(), helpers.begin() + (threads - 1));
+		position_history rootHistory;
+		rootHistory.push(createZobrishHash(position, positionInfo));
+		for(search_worker* w: workers) {
+			w->setPosition(position, positionInfo, rootHistory);
+			w->newSearch();
 		}
-		int bestEvaluation = WORST_VALUE;
-		move bestMove;
-		for(unsigned int i = 0; i<moves.size(); ++i) { //iterate moves, some was already checked for legality!
-			move& move = moves[i];
-			bool isLegal = legalityChecks[i].checked ? legalityChecks[i].legal : isLegalMove(move, board, gameInfo);
-			if(isLegal) { //only evaluate this moves if it ends up being legal
-				int capturedPiece = board.makeMove(move, side);
-				game_information infoAfterMove = gameInfo; //create a game info object
-				updateGameInformation(board, move, infoAfterMove); //update new info object with move
-				int evaluation = -alphaBetaNegamax(-beta, -alpha, depthLeft - 1, infoAfterMove); //move down in the tree
-				board.unmakeMove(move, side, capturedPiece); //unmake the move before moving on
-				if(evaluation > bestEvaluation) {
-					bestEvaluation = evaluation;
-					bestMove = move;
-				}
-				if(bestEvaluation > alpha) {
-					alpha = bestEvaluation;
+		worker.orderRootMoves(moves, NULLMOVE);
+		//results of the last completed iteration, in the order to search them in the next
+		std::vector<root_move_result> results;
+		for(const move& m: moves) {
+			results.push_back(root_move_result(m, WORST_VALUE, std::vector<move>()));
+		}
+		ttable->newSearch();
+		statistics.clear();
+		control.nodes = 0;
+		unsigned long long nodesBeforeIteration = 0;
+		auto searchStart = std::chrono::steady_clock::now();
+		if(options.timeLimit > 0) {
+			control.deadline = (searchStart + std::chrono::milliseconds(options.timeLimit)).time_since_epoch().count();
+		}
+		for(unsigned int iterationDepth = 1; iterationDepth <= depth && !results.empty(); ++iterationDepth) {
+			auto iterationStart = std::chrono::steady_clock::now();
+			std::vector<root_move_result> iterationResults(results);
+			std::vector<bool> exact(results.size(), false);
+			std::multiset<int, std::greater<int>> exactScores; //scores of the moves searched with full window
+			std::mutex resultLock;
+			std::atomic<unsigned int> nextMove(0);
+			//the threads take the next unsearched move until none is left
+			auto searchMoves = [&](search_worker& w) {
+				for(unsigned int i = nextMove++; i < results.size() && !control.stop; i = nextMove++) {
+					const move& m = results[i].rootMove;
+					int kthScore = WORST_VALUE; //moves below the K-th best exact score are not interesting
+					{
+						std::lock_guard<std::mutex> lock(resultLock);
+						if(exactScores.size() >= multiPv) kthScore = *std::next(exactScores.begin(), multiPv - 1);
+					}
+					w.setPreviousPv(results[i].pv);
+					int score;
+					bool scoreExact = true;
+					if(i < multiPv || kthScore == WORST_VALUE) {
+						score = w.searchRootMove(m, WORST_VALUE, BEST_VALUE, iterationDepth);
+					} else {
+						score = w.searchRootMove(m, kthScore, kthScore+1, iterationDepth);
+						scoreExact = false; //upper bound
+						if(score > kthScore) { //better than the K-th move, get its exact score
+							score = w.searchRootMove(m, kthScore, BEST_VALUE, iterationDepth);
+							scoreExact = score > kthScore; //it can still fail low on the re-search
+						}
+					}
+					if(control.stop) break; //the score is not reliable
+					std::lock_guard<std::mutex> lock(resultLock);
+					iterationResults[i].score = score;
+					iterationResults[i].pv = scoreExact ? w.getLine() : std::vector<move>();
+					exact[i] = scoreExact;
+					if(scoreExact) exactScores.insert(score);
 				}
-				if(bestEvaluation >= beta) {
-					break;
+			};
+			std::vector<std::thread> threadPool;
+			for(unsigned int t = 1; t < workers.size(); ++t) {
+				threadPool.push_back(std::thread(searchMoves, std::ref(*workers[t])));
+			}
+			searchMoves(worker);
+			for(std::thread& thread: threadPool) {
+				thread.join();
+			}
+			bool stopped = control.stop;
+			if(stopped && iterationDepth > 1) break; //only completed iterations are used, unless this was the first
+			if(stopped) { //keep the moves of the first iteration that got an exact score, the others stay unsearched
+				for(unsigned int i = 0; i < results.size(); ++i) {
+					if(!exact[i]) iterationResults[i] = results[i];
 				}
 			}
+			//exact scores first when equal: an upper bound equal to the K-th score is not better than it
+			std::vector<unsigned int> order(results.size());
+			for(unsigned int i = 0; i < order.size(); ++i) order[i] = i;
+			std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+				if(iterationResults[a].score != iterationResults[b].score) return iterationResults[a].score > iterationResults[b].score;
+				return exact[a] && !exact[b];
+			});
+			results.clear();
+			for(unsigned int i: order) {
+				results.push_back(iterationResults[i]);
+			}
+			if(stopped) break;
+			unsigned long long nodes = 0;
+			for(search_worker* w: workers) {
+				nodes += w->getStatistics().nodes;
+			}
+			auto iterationEnd = std::chrono::steady_clock::now();
+			double seconds = std::chrono::duration<double>(iterationEnd - searchStart).count();
+			statistics.iterations.push_back(iteration_statistics(iterationDepth, nodes - nodesBeforeIteration,
+					std::chrono::duration<double>(iterationEnd - iterationStart).count(), results[0].score));
+			nodesBeforeIteration = nodes;
+			for(unsigned int i = 0; i < multiPv && i < results.size(); ++i) {
+				std::cout << "PV " << (i+1) << ": ";
+				printPrincipalVariation(rootBoard, positionInfo, results[i].pv, iterationDepth, results[i].score, nodes, seconds);
+			}
 		}
-		//store move in the transposition table
-		unsigned short entryType;
-		if(bestEvaluation <= alphaOriginal) {
-			entryType = upperBound;
-		} else if(bestEvaluation >= beta) {
-			entryType = lowerBound;
-		} else {
-			entryType = exact;
+		for(search_worker* w: workers) {
+			statistics.merge(w->getStatistics());
+		}
+		statistics.ttOccupancy = ttable->occupancy();
+		statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - searchStart).count();
+		control.stop = false;
+		control.deadline = 0;
+		if(results.size() > multiPv) {
+			results.resize(multiPv, results[0]);
 		}
-		transposition_entry newEntry(zobristKey, entryType, depth, bestEvaluation, false, bestMove);
-		ttable->put(zobristKey, newEntry);
-		return alpha;
+		return results;
 	}
 
 	move engine::makeMove(const game& gameController) {
 		const std::vector<move>& gameMoves = gameController.getMoves();
-		if(gameMoves.size() > 0) {
+		bool ponderHit = false;
+		if(ponderThread.joinable()) { //the opponent moved while pondering
+			ponderHit = stopPondering(gameMoves.back());
+		}
+		if(gameMoves.size() > 0 && !ponderHit) { //on a ponder hit the enemy move is already on the board
 			move enemyMove = gameMoves.back(); //update our board with enemy move
 			board.makeMove(enemyMove, 1-side);
 			updateGameInformation(board, enemyMove, info); //update game information
 		}
+		history = gameController.getPositionHistory(); //positions that the search may repeat
 		move bestMove;
 		move bookMove = NULLMOVE;
 		if(opening) bookMove = openingBook.getBookMove(board, info);
 		if(!(bookMove == NULLMOVE)) { //found a book opening
 			std::cout << "I am playing from my opening book!" << std::endl;
 			bestMove = bookMove;
+		} else if(ponderHit) {
+			std::cout << "The move I was expecting, I already know my answer!" << std::endl;
+			bestMove = ponderResult;
+			reportStatistics(); //of the ponder search
 		} else {
 			std::cout << "I am looking for my move..." << std::endl;
 			opening = false; //not in the opening anymore
 			bestMove = alphaBetaNegamaxRoot();
+			reportStatistics();
 		}
 		//std::cout << "My board before my move:\n" << board.to_string();
 		//update out board with the selected move
 		board.makeMove(bestMove, side); //keep board updated
 		updateGameInformation(board, bestMove, info);
+		if(options.ponder && !opening) {
+			startPondering();
+		}
 		return bestMove;
 	}
 
+	void engine::reportStatistics() const {
+		if(options.printStatistics) {
+			statistics.print(std::cout);
+		}
+		if(!options.statisticsFile.empty()) {
+			std::ofstream file(options.statisticsFile, std::ios::app);
+			file << statistics.toJson() << std::endl;
+		}
+	}
+
+	void engine::startPondering() {
+		if(previousPv.size() < 2) return; //no expected reply
+		ponderMove = previousPv[1];
+		history.push(createZobrishHash(board, info)); //position after our move, the game did not add it yet
+		infoBeforePonder = info;
+		ponderCapturedPiece = board.makeMove(ponderMove, 1-side);
+		updateGameInformation(board, ponderMove, info);
+		std::vector<move> replies;
+		move_generator generator(board, info);
+		generator.generatePseudoLegalMoves(side, replies);
+		auto legal = [&](const move& m) { return isLegalMove(m, board, info); };
+		if(std::none_of(replies.begin(), replies.end(), legal)) { //the expected reply ends the game, nothing to ponder
+			board.unmakeMove(ponderMove, 1-side, ponderCapturedPiece);
+			info = infoBeforePonder;
+			history.pop();
+			return;
+		}
+		history.push(createZobrishHash(board, info));
+		control.pondering = true;
+		ponderThread = std::thread([this]() {
+			ponderResult = alphaBetaNegamaxRoot();
+		});
+	}
+
+	bool engine::stopPondering(const move& opponentMove) {
+		bool ponderHit = opponentMove == ponderMove;
+		if(ponderHit) { //the search continues, from now on with the normal limits
+			if(options.timeLimit > 0) {
+				control.deadline = (std::chrono::steady_clock::now() + std::chrono::milliseconds(options.timeLimit)).time_since_epoch().count();
+			}
+			control.pondering = false;
+		} else {
+			control.stop = true; //the search is useless, stop it
+		}
+		ponderThread.join();
+		control.stop = false;
+		control.deadline = 0;
+		control.pondering = false;
+		if(!ponderHit) { //restore the position before the ponder move
+			board.unmakeMove(ponderMove, 1-side, ponderCapturedPiece);
+			info = infoBeforePonder;
+		}
+		return ponderHit;
+	}
+
+	void engine::newGame() {
+		if(ponderThread.joinable()) { //the last game ended while pondering
+			control.stop = true;
+			ponderThread.join();
+			control.stop = false;
+			control.pondering = false;
+		}
+		board = chessboard();
+		info = game_information();
+		opening = true;
+		history.clear();
+		previousPv.clear();
+		ttable->clear(options.threads);
+	}
+
+	void engine::loadHashFile() {
+		if(options.hashFile.empty()) return;
+		if(ttable->load(options.hashFile)) {
+			options.hashSize = ttable->megabytes(); //the saved size is used
+			std::cout << "Transposition table loaded from " << options.hashFile << std::endl;
+		} else { //no usable file, the table is created empty now
+			ttable->resize(options.hashSize, options.threads);
+		}
+	}
+
+	void engine::saveHashFile() const {
+		if(options.hashFile.empty()) return;
+		try {
+			ttable->save(options.hashFile);
+		} catch(const std::runtime_error& e) { //called from the destructor, must not throw
+			std::cout << e.what() << std::endl;
+		}
+	}
+
+	void engine::setHashSize(unsigned int megabytes) {
+		options.hashSize = megabytes;
+		ttable->resize(megabytes, options.threads);
+	}
+
 	std::string engine::description() const {
 		std::string sideName = side == white ? "White" : "Black";
 		return "Tchess engine (" + sideName + ")";
@@ -10,10 +10,15 @@
 #ifndef SRC_ENGINE_ENGINE_H_
 #define SRC_ENGINE_ENGINE_H_
 
+#include <thread>
+#include <atomic>
+#include <vector>
+
 #include "game/player.h"
 #include "polyglot.h"
 #include "transposition_table.h"
-#include "move_ordering.h"
+#include "search_statistics.h"
+#include "search_worker.h"
 
 namespace tchess
 {
@@ -22,6 +27,23 @@ namespace tchess
 	 */
 	extern const unsigned int default_depth;
 
+	/*
+	 * A root move found by the multi-PV analysis.
+	 */
+	struct root_move_result {
+
+		move rootMove;
+
+		//Score of the move, from the view of the side to move.
+		int score;
+
+		//Principal variation, starting with the root move.
+		std::vector<move> pv;
+
+		root_move_result(const move& rootMove, int score, const std::vector<move>& pv)
+			: rootMove(rootMove), score(score), pv(pv) {}
+	};
+
 	/*
 	 * Player agent for the Tchess engine.
 	 */
@@ -33,6 +55,9 @@ namespace tchess
 		//Search depth.
 		unsigned int depth;
 
+		//Parameters of the search.
+		search_options options;
+
 		//Board object.
 		chessboard board;
 
@@ -50,15 +75,58 @@ namespace tchess
 		 */
 		transposition_table* ttable;
 
+		//Stop flag and limits of the running search.
+		search_control control;
+
+		//Searches the moves of the root on the thread of the search.
+		search_worker worker;
+
+		//Additional workers of the multi-PV analysis, created when first needed.
+		std::vector<search_worker*> helpers;
+
+		//Counters of the last search, of all workers.
+		search_statistics statistics;
+
+		//Hash keys of the positions of the game.
+		position_history history;
+
+		//Principal variation of the last completed iteration.
+		std::vector<move> previousPv;
+
+		//Background thread of the ponder search.
+		std::thread ponderThread;
+
+		//The expected reply of the opponent, that is made on the board while pondering.
+		move ponderMove;
+
+		//The piece captured by the ponder move, to unmake it.
+		int ponderCapturedPiece;
+
+		//Game information before the ponder move, to restore it on a ponder miss.
+		game_information infoBeforePonder;
+
+		//The best move found by the ponder search.
+		move ponderResult;
+
 	public:
 		engine() = delete;
 
-		engine(unsigned int side, unsigned int depth = default_depth)
-			: side(side), depth(depth), opening(true) {
-			ttable = new transposition_table(def_transposition_table_size);
+		engine(unsigned int side, unsigned int depth = default_depth, const search_options& options = search_options())
+			: side(side), depth(depth), options(options), opening(true), openingBook(this->options.openingBook),
+			  ttable(new transposition_table(this->options.hashSize, this->options.threads, this->options.hashFile.empty())), worker(this->options, *ttable, control),
+			  ponderCapturedPiece(0) {
+			loadHashFile();
 		}
 
 		~engine() {
+			if(ponderThread.joinable()) { //the game ended while pondering
+				control.stop = true;
+				ponderThread.join();
+			}
+			for(search_worker* helper: helpers) {
+				delete helper;
+			}
+			saveHashFile();
 			delete ttable;
 		}
 
@@ -70,20 +138,82 @@ namespace tchess
 
 		std::string description() const;
 
+		/*
+		 * Stops the running search, it will return the best move it found so far. Can be called from any thread.
+		 * If no search is running, the next one stops right away.
+		 */
+		void stop() {
+			control.stop = true;
+		}
+
+		/*
+		 * Prepares the engine for a new game: the transposition table and the position history
+		 * are emptied, and the opening book is used again.
+		 */
+		void newGame();
+
+		/*
+		 * Changes the size of the transposition table (in megabytes), the table will be empty. Must not be
+		 * called during a search.
+		 */
+		void setHashSize(unsigned int megabytes);
+
+		/*
+		 * Statistics of the last search.
+		 */
+		const search_statistics& getStatistics() const {
+			return statistics;
+		}
+
+		/*
+		 * Multi-PV analysis: finds the best K (multi PV) moves of a position instead of only the best one. Uses
+		 * iterative deepening, in every iteration the best K moves of the previous one are searched with full
+		 * window, the others with a null window at the K-th best score: they are only searched again with a full
+		 * window if they beat it. The root moves are shared between the threads given in the options.
+		 * Returns at most K moves with their scores and lines, best first. If the analysis is stopped during the
+		 * first iteration, the moves it did not finish have WORST_VALUE score and an empty line.
+		 */
+		std::vector<root_move_result> analyze(const chessboard& position, const game_information& positionInfo, unsigned int multiPv);
+
 	private:
 		/*
 		 * The root negamax function. Unlike the normal negamax, this
-		 * will return the best move instead of the best evaluation.
+		 * will return the best move instead of the best evaluation. Uses iterative deepening:
+		 * searches with depth 1, 2, ... until the search depth, and the principal variation of an
+		 * iteration is searched first in the next one. Returns NULLMOVE if the side to move has no legal move.
 		 */
 		move alphaBetaNegamaxRoot();
 
 		/*
-		 * Negamax tree searching method with alpha-beta cutoff.
-		 * - depth left: Current search depth. If this is 0, then we dont go deeper and evaluate.
-		 * - game info: the non-reversible elements of the board. These are copy made and passed in.
-		 * - pvLine: collected principal variation of the parent node.
+		 * Loads the transposition table from the hash file of the options, if it is set and the file exists.
+		 * If the hash file is set, the table is not allocated until this is called, and it is only allocated
+		 * and cleared when the file can't be used.
 		 */
-		int alphaBetaNegamax(int alpha, int beta, unsigned int depthLeft, game_information& gameInfo);
+		void loadHashFile();
+
+		/*
+		 * Saves the transposition table into the hash file of the options, if it is set.
+		 */
+		void saveHashFile() const;
+
+		/*
+		 * Prints the statistics of the last search and/or appends them to the statistics file, if enabled.
+		 */
+		void reportStatistics() const;
+
+		/*
+		 * Makes the expected reply of the opponent (second move of the principal variation) on the board,
+		 * then searches the position on the ponder thread. Called after the engine made its move.
+		 */
+		void startPondering();
+
+		/*
+		 * Called when the opponent has moved while pondering. If the opponent made the expected move (ponder hit),
+		 * then the ponder search is allowed to finish and true is returned: its result is the next move. Otherwise
+		 * the ponder search is stopped and the ponder move is unmade. What the transposition table learned is kept.
+		 */
+		bool stopPondering(const move& opponentMove);
+
 	};
 
 }
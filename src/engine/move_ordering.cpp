@@ -6,8 +6,12 @@
  */
 #include <stack>
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
 
 #include "move_ordering.h"
+#include "board/evaluation.h"
 
 namespace tchess
 {
@@ -19,8 +23,138 @@ namespace tchess
 		move_data(const move& m, unsigned int side, int capt) : m(m), side(side), capturedPiece(capt) {}
 	};
 
-	void printPrincipalVariation(chessboard& board, const game_information& info, unsigned int depth) {
+	void printPrincipalVariation(chessboard& board, const game_information& info, const std::vector<move>& pv,
+			unsigned int depth, int score, unsigned long long nodes, double seconds) {
+		std::cout << "Depth " << depth << ", score: ";
+		if(isMateScore(score)) { //mated side gets WORST_VALUE + plies to mate
+			int plies = score > 0 ? -WORST_VALUE - score : score - WORST_VALUE;
+			std::cout << (score > 0 ? "mate in " : "mated in ") << (plies + 1) / 2;
+		} else {
+			std::cout << score;
+		}
+		std::cout << ", nodes: " << nodes << ", nodes/s: " << (unsigned long long)(seconds > 0 ? nodes / seconds : 0)
+				<< ", line:";
+		std::stack<move_data> madeMoves;
+		unsigned int side = info.getSideToMove();
+		for(const move& m: pv) { //make the moves to see which piece moves
+			int piece = std::abs(board[m.getFromSquare()]);
+			std::cout << " " << m.to_string(piece);
+			madeMoves.push(move_data(m, side, board.makeMove(m, side)));
+			side = 1 - side;
+		}
+		std::cout << std::endl;
+		while(!madeMoves.empty()) { //restore the board
+			const move_data& md = madeMoves.top();
+			board.unmakeMove(md.m, md.side, md.capturedPiece);
+			madeMoves.pop();
+		}
+	}
 
+	void principal_variation::update(unsigned int ply, const move& m) {
+		lines[ply][0] = m;
+		unsigned int childLength = ply + 1 < max_search_ply ? lengths[ply+1] : 0;
+		for(unsigned int i = 0; i < childLength; ++i) {
+			lines[ply][i+1] = lines[ply+1][i];
+		}
+		lengths[ply] = std::min(childLength + 1, max_search_ply - ply);
+	}
+
+	std::vector<move> principal_variation::getLine() const {
+		return std::vector<move>(lines[0], lines[0] + lengths[0]);
+	}
+
+	//History scores stay in the [-maxHistory, maxHistory] range.
+	static const int maxHistory = 16384;
+
+	/*
+	 * Move score layers. Winning captures and promotions are above every quiet move, and
+	 * inside the quiet moves killers and countermoves are above the history scored ones. Losing
+	 * captures keep their plain MVV-LVA score, which is below the quiet layer.
+	 */
+	static const unsigned int captureScoreBase = 1000000;
+	static const unsigned int killerScore[2] = {900000, 890000};
+	static const unsigned int counterMoveScore = 880000;
+	static const unsigned int quietScoreBase = 100000;
+
+	//Quiet checking moves are ordered as if their history score was this much higher.
+	static const int checkBonus = maxHistory;
+
+	move_ordering_heuristics::move_ordering_heuristics() {
+		clear();
+	}
+
+	void move_ordering_heuristics::clear() {
+		for(unsigned int ply = 0; ply < max_search_ply; ++ply) {
+			killers[ply][0] = NULLMOVE;
+			killers[ply][1] = NULLMOVE;
+		}
+		std::memset(history, 0, sizeof(history));
+		for(unsigned int from = 0; from < 64; ++from) {
+			for(unsigned int to = 0; to < 64; ++to) {
+				counterMoves[from][to] = NULLMOVE;
+			}
+		}
 	}
-}
 
+	void move_ordering_heuristics::newSearch() {
+		for(unsigned int ply = 0; ply < max_search_ply; ++ply) {
+			killers[ply][0] = NULLMOVE;
+			killers[ply][1] = NULLMOVE;
+		}
+		for(unsigned int side = 0; side < 2; ++side) {
+			for(unsigned int from = 0; from < 64; ++from) {
+				for(unsigned int to = 0; to < 64; ++to) {
+					history[side][from][to] /= 2; //aging
+				}
+			}
+		}
+	}
+
+	void move_ordering_heuristics::scoreMoves(std::vector<move>& moves, const chessboard& board, unsigned int side,
+			unsigned int ply, const move& previousMove) const {
+		const move& counterMove = counterMoves[previousMove.getFromSquare()][previousMove.getToSquare()];
+		bool hasCounterMove = !(previousMove == NULLMOVE) && !(counterMove == NULLMOVE);
+		for(move& m: moves) {
+			if(m.isPromotion() || (m.isCapture() && staticExchangeEvaluation(board, m, 0))) { //keep MVV-LVA order, but above quiet moves
+				m.setScore(captureScoreBase + m.getScore());
+			} else if(m.isCapture()) { //losing capture, MVV-LVA score is already below the quiet moves
+				continue;
+			} else if(m == killers[ply][0]) {
+				m.setScore(killerScore[0]);
+			} else if(m == killers[ply][1]) {
+				m.setScore(killerScore[1]);
+			} else if(hasCounterMove && m == counterMove) {
+				m.setScore(counterMoveScore);
+			} else { //shift history scores into positive range
+				int bonus = givesCheck(board, m, side) ? checkBonus : 0;
+				m.setScore(quietScoreBase + maxHistory + history[side][m.getFromSquare()][m.getToSquare()] + bonus);
+			}
+		}
+	}
+
+	bool move_ordering_heuristics::isKiller(unsigned int ply, const move& m) const {
+		return m == killers[ply][0] || m == killers[ply][1];
+	}
+
+	void move_ordering_heuristics::quietCutoff(unsigned int side, unsigned int ply, int depthLeft, const move& cutoffMove,
+			const move& previousMove, const std::vector<move>& quietsTried) {
+		if(!(cutoffMove == killers[ply][0])) { //keep the 2 killers different
+			killers[ply][1] = killers[ply][0];
+			killers[ply][0] = cutoffMove;
+		}
+		if(!(previousMove == NULLMOVE)) {
+			counterMoves[previousMove.getFromSquare()][previousMove.getToSquare()] = cutoffMove;
+		}
+		//deeper cutoffs are more reliable, so they are worth more
+		int bonus = std::min(depthLeft * depthLeft, maxHistory);
+		updateHistory(side, cutoffMove, bonus);
+		for(const move& quiet: quietsTried) {
+			updateHistory(side, quiet, -bonus);
+		}
+	}
+
+	void move_ordering_heuristics::updateHistory(unsigned int side, const move& m, int bonus) {
+		int& score = history[side][m.getFromSquare()][m.getToSquare()];
+		score += bonus - score * std::abs(bonus) / maxHistory;
+	}
+}
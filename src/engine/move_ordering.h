@@ -8,15 +8,126 @@
 #ifndef SRC_ENGINE_MOVE_ORDERING_H_
 #define SRC_ENGINE_MOVE_ORDERING_H_
 
+#include <vector>
+
 #include "board/board.h"
 
 namespace tchess
 {
 	/*
-	 * Extracts the principal variation (best move sequence) . Then prints it.
+	 * Maximum distance from the root (in plies) that the per ply tables of the search are prepared for.
+	 */
+	const unsigned int max_search_ply = 128;
+
+	/*
+	 * Prints the principal variation (best move sequence) of a completed search iteration, together with
+	 * the depth, the score and the amount of nodes searched. The moves are made on the board to find out
+	 * which pieces moved, then unmade.
+	 */
+	void printPrincipalVariation(chessboard& board, const game_information& info, const std::vector<move>& pv,
+			unsigned int depth, int score, unsigned long long nodes, double seconds);
+
+	/*
+	 * Triangular principal variation table. Row 'ply' stores the best line found from the node at that
+	 * ply: when a move raises alpha (without a cutoff) the line becomes the move followed by the line of
+	 * the child node. This only happens in principal variation nodes, so copying is rare. Row 0 is the
+	 * principal variation of the search.
+	 */
+	class principal_variation {
+
+		//Best lines of each ply.
+		move lines[max_search_ply][max_search_ply];
+
+		//Length of the lines.
+		unsigned int lengths[max_search_ply];
+
+	public:
+		principal_variation() : lengths{0} {}
+
+		/*
+		 * Called when a node is entered: the line of an earlier node at this ply is no longer valid.
+		 */
+		inline void clear(unsigned int ply) {
+			lengths[ply] = 0;
+		}
+
+		/*
+		 * The best move of the node at the ply has changed: its line is the move and the line of the child.
+		 */
+		void update(unsigned int ply, const move& m);
+
+		/*
+		 * Returns the principal variation (line of the root).
+		 */
+		std::vector<move> getLine() const;
+	};
+
+	/*
+	 * Stores the heuristics that are used to order quiet moves. The move generator only gives
+	 * scores to captures and promotions (MVV-LVA), so without these all quiet moves are equal.
+	 *  - Killer moves: 2 quiet moves per ply that recently caused a beta cutoff at the same ply.
+	 *  - History: butterfly table indexed by side, departure and destination square. Quiet moves
+	 *  causing cutoffs get a bonus, the quiet moves tried before them a penalty.
+	 *  - Countermove: the quiet move that refuted the previous move (indexed by its squares).
 	 */
-	void printPrincipalVariation(chessboard& board, const game_information& info, unsigned int depth);
+	class move_ordering_heuristics {
+
+		//Two killer slots for each ply, the first one is the most recent.
+		move killers[max_search_ply][2];
+
+		//History scores, always between -maxHistory and maxHistory.
+		int history[2][64][64];
+
+		//Refutations of the previous move, indexed by the departure and destination of the previous move.
+		move counterMoves[64][64];
+
+	public:
+		/*
+		 * Creates empty tables.
+		 */
+		move_ordering_heuristics();
+
+		/*
+		 * Forgets everything, for example at the start of a new game.
+		 */
+		void clear();
+
+		/*
+		 * Called before each new search: killers are forgotten (they belong to other plies now) and
+		 * the history scores are halved, so that recent cutoffs matter more than old ones.
+		 */
+		void newSearch();
+
+		/*
+		 * Gives the move scores that the moves will be sorted by. Captures and promotions keep their MVV-LVA score,
+		 * and are split by static exchange evaluation: winning and equal captures are moved above all quiet moves,
+		 * losing captures below them. Quiet moves are ordered: killers, countermove, then by history, where checking
+		 * moves get a bonus.
+		 * - previous move: the move that lead to this position, NULLMOVE at the root or after a null move.
+		 */
+		void scoreMoves(std::vector<move>& moves, const chessboard& board, unsigned int side, unsigned int ply,
+				const move& previousMove) const;
+
+		/*
+		 * Checks if a move is one of the killer moves at this ply.
+		 */
+		bool isKiller(unsigned int ply, const move& m) const;
+
+		/*
+		 * Updates the tables after a quiet move caused a beta cutoff.
+		 * - quiets tried: the quiet moves that were searched before the cutoff move, and failed to cause a cutoff.
+		 */
+		void quietCutoff(unsigned int side, unsigned int ply, int depthLeft, const move& cutoffMove,
+				const move& previousMove, const std::vector<move>& quietsTried);
+
+	private:
 
+		/*
+		 * Applies a bonus (or penalty if negative) to a history score. The more extreme the score already is,
+		 * the less it changes ("gravity"), so scores never leave the allowed range.
+		 */
+		void updateHistory(unsigned int side, const move& m, int bonus);
+	};
 }
 
 #endif /* SRC_ENGINE_MOVE_ORDERING_H_ */
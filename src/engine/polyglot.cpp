@@ -6,6 +6,14 @@
  */
 #include <cstdio>
 #include <random>
+#include <algorithm>
+#include <string>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include <utility>
 #include <vector>
 
@@ -316,48 +324,80 @@ namespace tchess
 		}
 	}
 
-	opening_book::opening_book() {
+	//! Byte swap unsigned short
+	unsigned short swap_uint16(unsigned short val) {
+	    return (val << 8) | (val >> 8 );
+	}
+
+	//! Byte swap unsigned int
+	unsigned int swap_uint32(unsigned int val) {
+	    val = ((val << 8) & 0xFF00FF00 ) | ((val >> 8) & 0xFF00FF );
+	    return (val << 16) | (val >> 16);
+	}
+
+	// byte swap unsigned long long
+	uint64 swap_uint64(uint64 val) {
+	    val = ((val << 8) & 0xFF00FF00FF00FF00ULL ) | ((val >> 8) & 0x00FF00FF00FF00FFULL );
+	    val = ((val << 16) & 0xFFFF0000FFFF0000ULL ) | ((val >> 16) & 0x0000FFFF0000FFFFULL );
+	    return (val << 32) | (val >> 32);
+	}
+
+	const char* const def_opening_book = "res/Perfect2021.bin";
+
+	opening_book::opening_book(const std::string& path) : entriesNumber(0), entries(nullptr), mappedBytes(0) {
+#ifdef _WIN32
 		//read entries into memory
-		FILE* bookFile = std::fopen("res\\codekiddy.bin", "rb");
+		FILE* bookFile = std::fopen(path.c_str(), "rb");
 		if(bookFile != NULL) {
 			fseek(bookFile, 0, SEEK_END);
 			//check the amount of entries
 			unsigned int pos = ftell(bookFile);
 			if(pos < sizeof(polyglot_book_entry)) {
+				fclose(bookFile);
 				throw std::runtime_error("Opening book is empty!");
 			}
 			entriesNumber = pos / sizeof(polyglot_book_entry);
 			//allocate memory for book
-			entries = new polyglot_book_entry[entriesNumber];
+			polyglot_book_entry* readEntries = new polyglot_book_entry[entriesNumber];
 			//go to start of file
 			rewind(bookFile);
 			//read in entries
-			fread(entries, sizeof(polyglot_book_entry),	entriesNumber, bookFile);
+			fread(readEntries, sizeof(polyglot_book_entry),	entriesNumber, bookFile);
+			fclose(bookFile);
+			entries = readEntries;
 		} else {
-			throw std::runtime_error("Opening book file not found!");
+			throw std::runtime_error("Opening book file not found: " + path);
+		}
+#else
+		int descriptor = open(path.c_str(), O_RDONLY);
+		if(descriptor < 0) {
+			throw std::runtime_error("Opening book file not found: " + path);
+		}
+		struct stat fileStatus;
+		if(fstat(descriptor, &fileStatus) != 0 || fileStatus.st_size < (off_t)sizeof(polyglot_book_entry)) {
+			close(descriptor);
+			throw std::runtime_error("Opening book is empty!");
 		}
+		//check the amount of entries
+		entriesNumber = fileStatus.st_size / sizeof(polyglot_book_entry);
+		mappedBytes = (size_t)entriesNumber * sizeof(polyglot_book_entry);
+		//read only mapping: the pages are loaded when a lookup touches them, and shared with every other mapping of the file
+		void* mapping = mmap(nullptr, mappedBytes, PROT_READ, MAP_SHARED, descriptor, 0);
+		close(descriptor); //the mapping keeps the file open
+		if(mapping == MAP_FAILED) {
+			throw std::runtime_error("Can't map opening book: " + path);
+		}
+		madvise(mapping, mappedBytes, MADV_RANDOM); //binary search, reading ahead is useless
+		entries = static_cast<const polyglot_book_entry*>(mapping);
+#endif
 	}
 
 	opening_book::~opening_book() {
+#ifdef _WIN32
 		delete[] entries;
-	}
-
-	//! Byte swap unsigned short
-	unsigned short swap_uint16(unsigned short val) {
-	    return (val << 8) | (val >> 8 );
-	}
-
-	//! Byte swap unsigned int
-	unsigned int swap_uint32(unsigned int val) {
-	    val = ((val << 8) & 0xFF00FF00 ) | ((val >> 8) & 0xFF00FF );
-	    return (val << 16) | (val >> 16);
-	}
-
-	// byte swap unsigned long long
-	uint64 swap_uint64(uint64 val) {
-	    val = ((val << 8) & 0xFF00FF00FF00FF00ULL ) | ((val >> 8) & 0x00FF00FF00FF00FFULL );
-	    val = ((val << 16) & 0xFFFF0000FFFF0000ULL ) | ((val >> 16) & 0x0000FFFF0000FFFFULL );
-	    return (val << 32) | (val >> 32);
+#else
+		munmap(const_cast<polyglot_book_entry*>(entries), mappedBytes);
+#endif
 	}
 
 	const static unsigned int defaultKingSquares[2] = {60, 4};
@@ -443,14 +483,15 @@ namespace tchess
 		//list moves from the book
 		std::vector<move> bookMoves;
 		std::vector<unsigned short> weights;
-		for(polyglot_book_entry* entry = entries; entry < entries + entriesNumber; entry++) {
-			if(boardKey == swap_uint64(entry->boardKey)) { //found the board in the book
-				moveKey = swap_uint16(entry->move);
-				move m = moveFromPolyKey(moveKey, board, info);
-				unsigned short weight = swap_uint16(entry->weight); //how good this move is
-				bookMoves.push_back(m);
-				weights.push_back(weight);
-			}
+		//the entries of the board are next to each other, starting from the first entry with a not smaller key
+		const polyglot_book_entry* first = std::lower_bound(entries, entries + entriesNumber, boardKey,
+				[](const polyglot_book_entry& entry, uint64 key) { return swap_uint64(entry.boardKey) < key; });
+		for(const polyglot_book_entry* entry = first; entry < entries + entriesNumber && swap_uint64(entry->boardKey) == boardKey; entry++) {
+			moveKey = swap_uint16(entry->move);
+			move m = moveFromPolyKey(moveKey, board, info);
+			unsigned short weight = swap_uint16(entry->weight); //how good this move is
+			bookMoves.push_back(m);
+			weights.push_back(weight);
 		}
 		if(bookMoves.size() > 0) {
 			std::default_random_engine generator;
@@ -14,6 +14,7 @@
 #define SRC_ENGINE_POLYGLOT_H_
 
 #include <iostream>
+#include <string>
 
 #include "board/board.h"
 
@@ -51,25 +52,44 @@ namespace tchess
 	};
 
 	/*
-	 * Represents the polyglot opening book. At creation it will read the contents
-	 * of the opening book into memory.
+	 * Path of the opening book used by default.
+	 */
+	extern const char* const def_opening_book;
+
+	/*
+	 * Represents the polyglot opening book. At creation the book file is mapped into the memory read only,
+	 * nothing is read or copied: the pages are loaded by the operating system when a lookup first touches them,
+	 * and are shared by all books (of any process) that map the same file. On Windows the book is read into
+	 * the memory. The file stores the numbers in big endian byte order, they are swapped when read.
 	 */
 	class opening_book {
 
 		//Amount of entries in the book.
 		long entriesNumber;
 
-		//Points to the entries in the memory.
-		polyglot_book_entry* entries;
+		//Points to the entries in the memory, sorted by board key (polyglot books are sorted like this).
+		const polyglot_book_entry* entries;
+
+		//Size of the mapping of the book file.
+		size_t mappedBytes;
 
 	public:
-		opening_book();
+		/*
+		 * Opens the book file, throws runtime_error if it does not exist or is empty.
+		 */
+		opening_book(const std::string& path = def_opening_book);
 
 		~opening_book();
 
+		//The book owns its mapping, it is never copied.
+		opening_book(const opening_book&) = delete;
+
+		opening_book& operator=(const opening_book&) = delete;
+
 		/*
 		 * Extract a move from the opening book to the given board position. If there is no
 		 * move found for the position, then the special invalid move (0,0,quietMove) is returned.
+		 * The entries of the position are found by binary search.
 		 */
 		move getBookMove(const chessboard& board, const game_information& info);
 	};
@@ -0,0 +1,152 @@
+/*
+ * search_statistics.cpp
+ */
+
+#include <sstream>
+
+#include "search_statistics.h"
+
+namespace tchess
+{
+	search_statistics::search_statistics() {
+		clear();
+	}
+
+	void search_statistics::clear() {
+		nodes = 0;
+		quiescenceNodes = 0;
+		ttProbes = 0;
+		ttHits = 0;
+		ttCutoffs = 0;
+		ttCollisions = 0;
+		ttOccupancy = 0;
+		ttProbeNanoseconds = 0;
+		for(unsigned int i = 0; i < cutoff_histogram_size; ++i) {
+			cutoffs[i] = 0;
+		}
+		nullMovePrunes = 0;
+		staticExchangePrunes = 0;
+		reverseFutilityPrunes = 0;
+		futilityPrunes = 0;
+		razoringPrunes = 0;
+		probCutAttempts = 0;
+		probCutCutoffs = 0;
+		lateMoveReductions = 0;
+		lateMoveResearches = 0;
+		checkExtensions = 0;
+		internalIterativeDeepenings = 0;
+		internalIterativeReductions = 0;
+		seconds = 0;
+		iterations.clear();
+	}
+
+	void search_statistics::merge(const search_statistics& other) {
+		nodes += other.nodes;
+		quiescenceNodes += other.quiescenceNodes;
+		ttProbes += other.ttProbes;
+		ttHits += other.ttHits;
+		ttCutoffs += other.ttCutoffs;
+		ttCollisions += other.ttCollisions;
+		ttProbeNanoseconds += other.ttProbeNanoseconds;
+		for(unsigned int i = 0; i < cutoff_histogram_size; ++i) {
+			cutoffs[i] += other.cutoffs[i];
+		}
+		nullMovePrunes += other.nullMovePrunes;
+		staticExchangePrunes += other.staticExchangePrunes;
+		reverseFutilityPrunes += other.reverseFutilityPrunes;
+		futilityPrunes += other.futilityPrunes;
+		razoringPrunes += other.razoringPrunes;
+		probCutAttempts += other.probCutAttempts;
+		probCutCutoffs += other.probCutCutoffs;
+		lateMoveReductions += other.lateMoveReductions;
+		lateMoveResearches += other.lateMoveResearches;
+		checkExtensions += other.checkExtensions;
+		internalIterativeDeepenings += other.internalIterativeDeepenings;
+		internalIterativeReductions += other.internalIterativeReductions;
+	}
+
+	double search_statistics::nodesPerSecond() const {
+		return seconds > 0 ? nodes / seconds : 0;
+	}
+
+	double search_statistics::ttHitRate() const {
+		return ttProbes > 0 ? (double)ttHits / ttProbes : 0;
+	}
+
+	double search_statistics::averageProbeNanoseconds() const {
+		return ttProbes > 0 ? (double)ttProbeNanoseconds / ttProbes : 0;
+	}
+
+	double search_statistics::firstMoveCutoffRate() const {
+		unsigned long long allCutoffs = 0;
+		for(unsigned int i = 0; i < cutoff_histogram_size; ++i) {
+			allCutoffs += cutoffs[i];
+		}
+		return allCutoffs > 0 ? (double)cutoffs[0] / allCutoffs : 0;
+	}
+
+	double search_statistics::effectiveBranchingFactor(unsigned int iterationIndex) const {
+		if(iterationIndex == 0 || iterationIndex >= iterations.size() || iterations[iterationIndex-1].nodes == 0) return 0;
+		return (double)iterations[iterationIndex].nodes / iterations[iterationIndex-1].nodes;
+	}
+
+	void search_statistics::print(std::ostream& out) const {
+		out << "Nodes: " << nodes << " (quiescence: " << quiescenceNodes << "), time: " << seconds
+				<< " s, nodes/s: " << (unsigned long long)nodesPerSecond() << "\n";
+		out << "Transposition table: " << ttProbes << " probes, " << ttHits << " hits, "
+				<< ttCutoffs << " cutoffs, " << ttCollisions << " collisions, hit rate: " << ttHitRate() * 100 << "%, occupancy: " << ttOccupancy * 100 << "%";
+		if(ttProbeNanoseconds > 0) {
+			out << ", average probe: " << averageProbeNanoseconds() << " ns";
+		}
+		out << "\n";
+		out << "Beta cutoffs by move index:";
+		for(unsigned int i = 0; i < cutoff_histogram_size; ++i) {
+			out << " " << cutoffs[i];
+		}
+		out << " (first move: " << firstMoveCutoffRate() * 100 << "%)\n";
+		out << "Pruned: null move " << nullMovePrunes << ", static exchange " << staticExchangePrunes
+				<< ", reverse futility " << reverseFutilityPrunes << ", futility " << futilityPrunes
+				<< ", razoring " << razoringPrunes << ", ProbCut " << probCutCutoffs
+				<< " (captures tried: " << probCutAttempts << ")\n";
+		out << "Late move reductions: " << lateMoveReductions << " (searched again: " << lateMoveResearches << ")"
+				<< ", check extensions: " << checkExtensions << "\n";
+		out << "No hash move: internal iterative deepening " << internalIterativeDeepenings
+				<< ", internal iterative reduction " << internalIterativeReductions << "\n";
+		for(unsigned int i = 0; i < iterations.size(); ++i) {
+			const iteration_statistics& it = iterations[i];
+			out << "Depth " << it.depth << ": " << it.nodes << " nodes, " << it.seconds << " s, score: " << it.score
+					<< ", branching factor: " << effectiveBranchingFactor(i) << "\n";
+		}
+		out.flush();
+	}
+
+	std::string search_statistics::toJson() const {
+		std::ostringstream json;
+		json << "{\"nodes\":" << nodes << ",\"quiescenceNodes\":" << quiescenceNodes
+				<< ",\"seconds\":" << seconds << ",\"nodesPerSecond\":" << nodesPerSecond()
+				<< ",\"tt\":{\"probes\":" << ttProbes << ",\"hits\":" << ttHits
+				<< ",\"cutoffs\":" << ttCutoffs << ",\"collisions\":" << ttCollisions << ",\"hitRate\":" << ttHitRate() << ",\"occupancy\":" << ttOccupancy
+				<< ",\"averageProbeNanoseconds\":" << averageProbeNanoseconds() << "}"
+				<< ",\"cutoffs\":[";
+		for(unsigned int i = 0; i < cutoff_histogram_size; ++i) {
+			json << (i > 0 ? "," : "") << cutoffs[i];
+		}
+		json << "],\"firstMoveCutoffRate\":" << firstMoveCutoffRate()
+				<< ",\"pruning\":{\"nullMove\":" << nullMovePrunes << ",\"staticExchange\":" << staticExchangePrunes
+				<< ",\"reverseFutility\":" << reverseFutilityPrunes << ",\"futility\":" << futilityPrunes
+				<< ",\"razoring\":" << razoringPrunes << ",\"probCut\":" << probCutCutoffs
+				<< ",\"probCutAttempts\":" << probCutAttempts << "}"
+				<< ",\"lateMoveReductions\":" << lateMoveReductions << ",\"lateMoveResearches\":" << lateMoveResearches
+				<< ",\"checkExtensions\":" << checkExtensions
+				<< ",\"internalIterativeDeepenings\":" << internalIterativeDeepenings
+				<< ",\"internalIterativeReductions\":" << internalIterativeReductions
+				<< ",\"iterations\":[";
+		for(unsigned int i = 0; i < iterations.size(); ++i) {
+			const iteration_statistics& it = iterations[i];
+			json << (i > 0 ? "," : "") << "{\"depth\":" << it.depth << ",\"nodes\":" << it.nodes << ",\"seconds\":" << it.seconds
+					<< ",\"score\":" << it.score << ",\"branchingFactor\":" << effectiveBranchingFactor(i) << "}";
+		}
+		json << "]}";
+		return json.str();
+	}
+}
@@ -0,0 +1,165 @@
+/*
+ * search_statistics.h
+ */
+
+#ifndef SRC_ENGINE_SEARCH_STATISTICS_H_
+#define SRC_ENGINE_SEARCH_STATISTICS_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace tchess
+{
+	/*
+	 * Beta cutoffs are counted by the index of the move that caused them, moves at
+	 * this index or later are counted together in the last slot.
+	 */
+	const unsigned int cutoff_histogram_size = 8;
+
+	/*
+	 * Data of one completed iterative deepening iteration.
+	 */
+	struct iteration_statistics {
+
+		unsigned int depth;
+
+		//Nodes searched in this iteration only.
+		unsigned long long nodes;
+
+		//Time of this iteration only.
+		double seconds;
+
+		//Score of the best move.
+		int score;
+
+		iteration_statistics(unsigned int depth, unsigned long long nodes, double seconds, int score)
+			: depth(depth), nodes(nodes), seconds(seconds), score(score) {}
+	};
+
+	/*
+	 * Counters collected during a search. The counters are plain integers, every searching thread
+	 * must have its own object, and these can be merged after the search.
+	 */
+	struct search_statistics {
+
+		//All visited nodes, including the quiescence nodes.
+		unsigned long long nodes;
+
+		//Nodes visited by the quiescence search.
+		unsigned long long quiescenceNodes;
+
+		//Transposition table lookups.
+		unsigned long long ttProbes;
+
+		//Lookups that found an entry of the same position.
+		unsigned long long ttHits;
+
+		//Lookups that returned a score without searching the node.
+		unsigned long long ttCutoffs;
+
+		//Stores that evicted the entry of another position from the current search.
+		unsigned long long ttCollisions;
+
+		//Ratio of the transposition table slots used by this search, when it ended.
+		double ttOccupancy;
+
+		//Time spent in transposition table lookups, only measured if enabled in the search options.
+		unsigned long long ttProbeNanoseconds;
+
+		//Beta cutoffs by the index of the cutoff move, the first slot is the first move cutoff.
+		unsigned long long cutoffs[cutoff_histogram_size];
+
+		//Nodes cut by null move pruning.
+		unsigned long long nullMovePrunes;
+
+		//Moves skipped because they lose material by static exchange evaluation.
+		unsigned long long staticExchangePrunes;
+
+		//Nodes cut because the static evaluation was far above beta.
+		unsigned long long reverseFutilityPrunes;
+
+		//Quiet moves skipped because the static evaluation was far below alpha.
+		unsigned long long futilityPrunes;
+
+		//Nodes resolved by the quiescence search because the static evaluation was far below alpha.
+		unsigned long long razoringPrunes;
+
+		//Captures searched by ProbCut.
+		unsigned long long probCutAttempts;
+
+		//Nodes cut by ProbCut.
+		unsigned long long probCutCutoffs;
+
+		//Moves searched with late move reduction.
+		unsigned long long lateMoveReductions;
+
+		//Reduced moves that had to be searched again to full depth.
+		unsigned long long lateMoveResearches;
+
+		//Checking moves searched one ply deeper.
+		unsigned long long checkExtensions;
+
+		//Reduced depth searches of nodes without a hash move, to find one.
+		unsigned long long internalIterativeDeepenings;
+
+		//Nodes searched with less depth because they had no hash move.
+		unsigned long long internalIterativeReductions;
+
+		//Time of the whole search.
+		double seconds;
+
+		//The completed iterations, in order.
+		std::vector<iteration_statistics> iterations;
+
+		search_statistics();
+
+		/*
+		 * Sets every counter to 0, called before each search.
+		 */
+		void clear();
+
+		/*
+		 * Adds the counters of another object (for example from another thread) to this. The
+		 * iterations are not merged, those are only recorded by the main thread.
+		 */
+		void merge(const search_statistics& other);
+
+		/*
+		 * Nodes per second of the search.
+		 */
+		double nodesPerSecond() const;
+
+		/*
+		 * The ratio of beta cutoffs caused by the first move searched. Good move ordering makes this high.
+		 */
+		double firstMoveCutoffRate() const;
+
+		/*
+		 * The ratio of transposition table lookups that found the position.
+		 */
+		double ttHitRate() const;
+
+		/*
+		 * Average time of a transposition table lookup in nanoseconds, 0 if it was not measured.
+		 */
+		double averageProbeNanoseconds() const;
+
+		/*
+		 * Nodes of the iteration divided by the nodes of the previous iteration. Returns 0 for the first iteration.
+		 */
+		double effectiveBranchingFactor(unsigned int iterationIndex) const;
+
+		/*
+		 * Prints the statistics in readable format.
+		 */
+		void print(std::ostream& out) const;
+
+		/*
+		 * Creates a JSON object (in one line) from the statistics.
+		 */
+		std::string toJson() const;
+	};
+}
+
+#endif /* SRC_ENGINE_SEARCH_STATISTICS_H_ */
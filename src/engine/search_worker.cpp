@@ -0,0 +1,462 @@
+/*
+ * search_worker.cpp
+ */
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+
+#include "search_worker.h"
+#include "board/evaluation.h"
+
+namespace tchess
+{
+	const unsigned int ignoreNoHashMove = 0;
+	const unsigned int internalIterativeDeepening = 1;
+	const unsigned int internalIterativeReduction = 2;
+
+	void search_worker::setPosition(const chessboard& rootBoard, const game_information& rootInfo, const position_history& rootHistory) {
+		board = rootBoard;
+		info = rootInfo;
+		history = rootHistory;
+	}
+
+	void search_worker::newSearch() {
+		ordering.newSearch();
+		statistics.clear();
+		previousPv.clear();
+		followPv = false;
+		nodesUntilLimitCheck = options.limitCheckNodes();
+		nodesReported = 0;
+	}
+
+	void search_worker::orderRootMoves(std::vector<move>& moves, const move& firstMove) {
+		ordering.scoreMoves(moves, board, info.getSideToMove(), 0, NULLMOVE);
+		for(move& m: moves) {
+			if(m == firstMove) m.setScore(std::numeric_limits<unsigned int>::max());
+		}
+		std::sort(moves.begin(), moves.end(), std::greater<move>());
+	}
+
+	int search_worker::searchRootMove(const move& rootMove, int alpha, int beta, int depthLeft) {
+		unsigned int side = info.getSideToMove();
+		int capturedPiece = board.makeMove(rootMove, side);
+		pathMoves[0] = rootMove;
+		game_information infoAfterMove = info; //create a game info object
+		updateGameInformation(board, rootMove, infoAfterMove); //update new info object with move
+		uint64 childKey = createZobrishHash(board, infoAfterMove); //only computed from scratch at the root
+		followPv = !previousPv.empty() && rootMove == previousPv[0];
+		rootDepth = depthLeft;
+		//a null window search is expected to prove that the move is not better: the child fails high
+		int evaluation = -alphaBetaNegamax(-beta, -alpha, depthLeft-1, 1, infoAfterMove, childKey, true, beta == alpha + 1);
+		followPv = false;
+		board.unmakeMove(rootMove, side, capturedPiece); //unmake the move before moving on
+		principalVariation.clear(0);
+		principalVariation.update(0, rootMove);
+		return evaluation;
+	}
+
+	void search_worker::checkLimits() {
+		nodesUntilLimitCheck = options.limitCheckNodes();
+		unsigned long long totalNodes = control.nodes += statistics.nodes - nodesReported;
+		nodesReported = statistics.nodes;
+		if(control.pondering) return; //pondering lasts until the opponent moves
+		if(options.nodeLimit > 0 && totalNodes >= options.nodeLimit) {
+			control.stop = true;
+		}
+		long long deadlineNow = control.deadline;
+		if(deadlineNow > 0 && std::chrono::steady_clock::now().time_since_epoch().count() >= deadlineNow) {
+			control.stop = true;
+		}
+	}
+
+	//Depth reduction of the null move search, larger when more depth is left.
+	static inline int nullMoveReduction(int depthLeft) {
+		return depthLeft > 6 ? 3 : 2;
+	}
+
+	/*
+	 * Late move reduction amounts, indexed by remaining depth and the index of the move
+	 * in the move list. Grows logarithmically with both.
+	 */
+	static int lmrTable[64][64];
+
+	static bool initLmrTable() {
+		for(int d = 0; d < 64; ++d) {
+			for(int m = 0; m < 64; ++m) {
+				lmrTable[d][m] = (d == 0 || m == 0) ? 0 : (int)(0.75 + std::log(d) * std::log(m) / 2.25);
+			}
+		}
+		return true;
+	}
+
+	static const bool lmrTableInitialized = initLmrTable();
+
+	int search_worker::lateMoveReduction(int depthLeft, unsigned int moveIndex) const {
+		int reduction = lmrTable[std::min(depthLeft, 63)][std::min(moveIndex, 63u)];
+		return std::min(reduction, depthLeft - 2); //always leave at least one ply to search
+	}
+
+	bool search_worker::nullMoveCutoff(int beta, int depthLeft, unsigned int ply, game_information& gameInfo, uint64 zobristKey, int& score) {
+		int reduction = nullMoveReduction(depthLeft);
+		int nullDepth = std::max(depthLeft - 1 - reduction, 0);
+		game_information infoAfterNullMove = gameInfo; //the original info object will "unmake" the null move
+		updateGameInformationNullMove(infoAfterNullMove);
+		uint64 keyAfterNullMove = updateZobrishHashNullMove(zobristKey, gameInfo, infoAfterNullMove);
+		if(options.ttPrefetch) ttable.prefetch(keyAfterNullMove);
+		pathMoves[ply] = NULLMOVE; //there is no countermove to a null move
+		history.push(zobristKey); //repetitions of this position are detected below the null move too
+		//null window around beta, and the enemy can't reply with another null move
+		int nullEvaluation = -alphaBetaNegamax(-beta, -beta+1, nullDepth, ply+1, infoAfterNullMove, keyAfterNullMove, false, false);
+		history.pop();
+		if(nullEvaluation < beta) return false; //passing was not good enough
+		if(isMateScore(nullEvaluation)) {
+			nullEvaluation = beta; //mate found after passing is not proven
+		}
+		if(depthLeft >= options.nullMoveVerificationDepth) {
+			//verify with a reduced normal search of the same side, no null moves in this node
+			int verification = alphaBetaNegamax(beta-1, beta, depthLeft - reduction, ply, gameInfo, zobristKey, false, true);
+			if(verification < beta) return false; //zugzwang suspected, search normally
+		}
+		score = nullEvaluation;
+		return true;
+	}
+
+	int search_worker::quiescence(int alpha, int beta, unsigned int ply, game_information& gameInfo) {
+		if(--nodesUntilLimitCheck == 0) checkLimits();
+		if(control.stop) return 0; //unwind, the result will not be used
+		++statistics.nodes;
+		++statistics.quiescenceNodes;
+		principalVariation.clear(ply);
+		unsigned int side = gameInfo.getSideToMove();
+		move_generator generator(board, gameInfo);
+		std::vector<move> moves;
+		//create pseudo legal moves for this board and side
+		generator.generatePseudoLegalMoves(side, moves);
+		bool legalMovesExist = false; //stores if any legal move was found
+		for(const move& m: moves) { //check moves for legality, but only until one legal is found
+			if(isLegalMove(m, board, gameInfo)) {
+				legalMovesExist = true;
+				break;
+			}
+		}
+		special_board sb = isSpecialBoard(side, board, legalMovesExist, ply); //detect mates and drawn games
+		if(sb.special) {
+			return sb.evaluation; //return special evaluation
+		}
+		int standPat = evaluateBoard(side, board, gameInfo, moves.size());
+		if(standPat >= beta || ply >= max_search_ply - 1) {
+			return standPat; //already good enough without capturing
+		}
+		alpha = std::max(alpha, standPat);
+		//only keep captures and queen promotions that don't lose material, they are searched in MVV-LVA order
+		auto notTactical = [&](const move& m) {
+			if(!m.isCapture() && !(m.isPromotion() && m.promotedTo() == queen)) return true;
+			return !staticExchangeEvaluation(board, m, 0);
+		};
+		moves.erase(std::remove_if(moves.begin(), moves.end(), notTactical), moves.end());
+		std::sort(moves.begin(), moves.end(), std::greater<move>());
+		for(const move& move: moves) {
+			if(!isLegalMove(move, board, gameInfo)) continue;
+			int capturedPiece = board.makeMove(move, side);
+			pathMoves[ply] = move;
+			game_information infoAfterMove = gameInfo;
+			updateGameInformation(board, move, infoAfterMove);
+			int evaluation = -quiescence(-beta, -alpha, ply+1, infoAfterMove);
+			board.unmakeMove(move, side, capturedPiece);
+			if(evaluation >= beta) {
+				return evaluation;
+			}
+			alpha = std::max(alpha, evaluation);
+		}
+		return alpha;
+	}
+
+	int search_worker::alphaBetaNegamax(int alpha, int beta, int depthLeft, unsigned int ply, game_information& gameInfo, uint64 zobristKey,
+			bool nullMoveAllowed, bool cutNode) {
+		if(depthLeft <= 0) { //we are at maximum search depth, resolve the captures and evaluate
+			return quiescence(alpha, beta, ply, gameInfo);
+		}
+		if(ply >= max_search_ply - 1) { //no room left in the per-ply tables, quiescence returns the static evaluation here
+			return quiescence(alpha, beta, ply, gameInfo);
+		}
+		if(--nodesUntilLimitCheck == 0) checkLimits();
+		if(control.stop) return 0; //unwind, the result will not be used
+		++statistics.nodes;
+		principalVariation.clear(ply);
+		//on the path of the previous principal variation, its next move is searched first
+		bool onPv = followPv && ply < previousPv.size();
+		followPv = false;
+		bool pvNode = beta != alpha + 1;
+		unsigned int side = gameInfo.getSideToMove();
+		int alphaOriginal = alpha;
+		//draw by the fifty-move rule or repetition, in the search one repetition is enough: it could be repeated again
+		if(gameInfo.getHalfmoveClock() >= 100 || history.isRepeated(zobristKey, gameInfo.getHalfmoveClock(), 1)) {
+			return 0;
+		}
+		transposition_entry entry;
+		++statistics.ttProbes;
+		move hashMove = NULLMOVE; //best move of this position in an earlier search
+		bool entryFound;
+		if(options.measureProbeTime) {
+			auto probeStart = std::chrono::steady_clock::now();
+			entryFound = ttable.find(zobristKey, entry, ply);
+			statistics.ttProbeNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - probeStart).count();
+		} else {
+			entryFound = ttable.find(zobristKey, entry, ply);
+		}
+		if(entryFound) {
+			++statistics.ttHits;
+			hashMove = entry.bestMove; //the move is useful for ordering even if the entry is not deep enough
+			if((int)entry.depth >= depthLeft && !pvNode) { //principal variation nodes are searched, to get their line
+				//found in transposition table
+				if(entry.entryType == exact) { //exact match
+					++statistics.ttCutoffs;
+					return entry.score;
+				} else if(entry.entryType == lowerBound) {
+					alpha = std::max(alpha, entry.score);
+				} else if(entry.entryType == upperBound) {
+					beta = std::min(beta, entry.score);
+				}
+				if(alpha >= beta) {
+					++statistics.ttCutoffs;
+					return entry.score;
+				}
+			}
+		}
+		if(onPv) {
+			hashMove = previousPv[ply];
+		}
+		move_generator generator(board, gameInfo);
+		std::vector<move> moves;
+		bool inCheck = isAttacked(board, 1-side, board.getKingSquare(side));
+		/*
+		 * Null move pruning: not in check, not in pawn endings (zugzwang) and never two null moves in a row. Not in
+		 * principal variation nodes, where a null window fail high would cut the line of the node short.
+		 */
+		if(options.nullMovePruning && nullMoveAllowed && !pvNode && depthLeft >= options.nullMoveMinDepth && !isMateScore(beta)
+				&& !inCheck && board.hasNonPawnMaterial(side)) {
+			int nullMoveScore;
+			if(nullMoveCutoff(beta, depthLeft, ply, gameInfo, zobristKey, nullMoveScore)) {
+				++statistics.nullMovePrunes;
+				return nullMoveScore;
+			}
+		}
+		bool movesGenerated = false;
+		/*
+		 * ProbCut: if a capture that doesn't lose material beats beta by a margin even in a reduced depth search,
+		 * then the full depth search would most likely fail high too. Cheap quiescence search filters first.
+		 */
+		if(options.probCut && !pvNode && !inCheck && depthLeft >= options.probCutMinDepth && !isMateScore(beta)) {
+			int probCutBeta = beta + options.probCutMargin;
+			generator.generatePseudoLegalMoves(side, moves);
+			movesGenerated = true;
+			std::sort(moves.begin(), moves.end(), std::greater<move>()); //MVV-LVA order
+			history.push(zobristKey);
+			int probCutScore = WORST_VALUE;
+			for(const move& move: moves) {
+				if(!move.isCapture() || !staticExchangeEvaluation(board, move, 0) || !isLegalMove(move, board, gameInfo)) continue;
+				++statistics.probCutAttempts;
+				int capturedPiece = board.makeMove(move, side);
+				pathMoves[ply] = move;
+				game_information infoAfterMove = gameInfo;
+				updateGameInformation(board, move, infoAfterMove);
+				int evaluation = -quiescence(-probCutBeta, -probCutBeta+1, ply+1, infoAfterMove);
+				if(evaluation >= probCutBeta) { //verify with the reduced depth search
+					uint64 childKey = updateZobrishHash(zobristKey, board, move, side, capturedPiece, gameInfo, infoAfterMove);
+					evaluation = -alphaBetaNegamax(-probCutBeta, -probCutBeta+1, depthLeft - options.probCutReduction, ply+1, infoAfterMove, childKey, true, false);
+				}
+				board.unmakeMove(move, side, capturedPiece);
+				if(evaluation >= probCutBeta) {
+					probCutScore = evaluation;
+					break;
+				}
+			}
+			history.pop();
+			if(control.stop) return 0;
+			if(probCutScore != WORST_VALUE) {
+				++statistics.probCutCutoffs;
+				return probCutScore;
+			}
+		}
+		/*
+		 * No move to search first: find one with a reduced depth search, or search this node with less depth. Not
+		 * in expected all nodes: every move is searched there anyway, so the order doesn't matter.
+		 */
+		if(hashMove == NULLMOVE && depthLeft >= options.noHashMoveMinDepth && (pvNode || cutNode)) {
+			if(options.noHashMoveHandling == internalIterativeDeepening) {
+				++statistics.internalIterativeDeepenings;
+				alphaBetaNegamax(alpha, beta, depthLeft - options.iidReduction, ply, gameInfo, zobristKey, false, cutNode);
+				transposition_entry iidEntry;
+				if(ttable.find(zobristKey, iidEntry, ply)) {
+					hashMove = iidEntry.bestMove;
+				}
+			} else if(options.noHashMoveHandling == internalIterativeReduction) {
+				++statistics.internalIterativeReductions;
+				--depthLeft;
+			}
+		}
+		/*
+		 * Pruning near the leaves. Not in principal variation nodes, where the exact score matters,
+		 * not in check and not when mates are in the window.
+		 */
+		bool pruningAllowed = !pvNode && !inCheck && !isMateScore(alpha) && !isMateScore(beta);
+		int staticEvaluation = no_static_evaluation;
+		bool futile = false; //quiet moves can't raise the evaluation above alpha
+		if(pruningAllowed && (depthLeft <= options.reverseFutilityMaxDepth || depthLeft <= options.futilityMaxDepth
+				|| depthLeft <= options.razoringMaxDepth)) {
+			//create pseudo legal moves for this board and side, the evaluation needs their amount
+			if(!movesGenerated) generator.generatePseudoLegalMoves(side, moves);
+			movesGenerated = true;
+			//the transposition table may already know the static evaluation
+			staticEvaluation = entryFound && entry.staticEvaluation != no_static_evaluation
+					? entry.staticEvaluation : evaluateBoard(side, board, gameInfo, moves.size());
+			int reverseFutilityEvaluation = staticEvaluation - options.reverseFutilityMargin * depthLeft;
+			if(options.reverseFutilityPruning && depthLeft <= options.reverseFutilityMaxDepth && reverseFutilityEvaluation >= beta) {
+				++statistics.reverseFutilityPrunes; //even after giving away the margin, it's still too good
+				return reverseFutilityEvaluation;
+			}
+			if(options.razoring && depthLeft <= options.razoringMaxDepth
+					&& staticEvaluation + options.razoringMargin * depthLeft < alpha) {
+				//far below alpha, only captures may help: check them with quiescence search
+				int quiescenceEvaluation = quiescence(alpha, beta, ply, gameInfo);
+				if(quiescenceEvaluation <= alpha) {
+					++statistics.razoringPrunes;
+					return quiescenceEvaluation;
+				}
+			}
+			futile = options.futilityPruning && depthLeft <= options.futilityMaxDepth
+					&& staticEvaluation + options.futilityMargin * depthLeft <= alpha;
+		}
+		bool seePruningAllowed = options.seePruning && pruningAllowed && depthLeft <= options.seePruningMaxDepth;
+		const move previousMove = pathMoves[ply-1];
+		int bestEvaluation = WORST_VALUE;
+		move bestMove;
+		unsigned int movesSearched = 0; //amount of legal moves searched so far
+		std::vector<move>& quiets = quietsTried[ply];
+		quiets.clear();
+		//searches a legal move and updates the best evaluation, returns true if the move caused a beta cutoff
+		auto searchMove = [&](const move& move) -> bool {
+			bool quiet = !move.isCapture() && !move.isPromotion();
+			//checking moves are extended, and futility pruning and late move reductions are not applied to them
+			bool checking = givesCheck(board, move, side);
+			if(futile && quiet && movesSearched > 0 && !checking) {
+				++statistics.futilityPrunes;
+				return false;
+			}
+			bool lmrCandidate = options.lateMoveReductions && depthLeft >= options.lmrMinDepth && movesSearched >= options.lmrFullDepthMoves
+					&& movesSearched > 0 && !inCheck && quiet && !checking && !ordering.isKiller(ply, move);
+			//only checks that don't lose material are extended, and only up to a ply limit, so that
+			//long checking sequences can't explode the search
+			int extension = 0;
+			if(checking && options.checkExtensions && ply < (unsigned int)(options.maxExtensionPlyFactor * rootDepth)
+					&& staticExchangeEvaluation(board, move, 0)) {
+				extension = 1;
+				++statistics.checkExtensions;
+			}
+			const int newDepth = depthLeft - 1 + extension;
+			int capturedPiece = board.makeMove(move, side);
+			game_information infoAfterMove = gameInfo; //create a game info object
+			updateGameInformation(board, move, infoAfterMove); //update new info object with move
+			//the bucket of the child is loaded while the rest of the move is prepared
+			uint64 childKey = updateZobrishHash(zobristKey, board, move, side, capturedPiece, gameInfo, infoAfterMove);
+			if(options.ttPrefetch) ttable.prefetch(childKey);
+			pathMoves[ply] = move;
+			followPv = onPv && move == previousPv[ply];
+			int evaluation;
+			if(movesSearched == 0) { //first move is expected to be the best, search it with full window
+				//the child is a principal variation node, or the opposite type of this null window node
+				evaluation = -alphaBetaNegamax(-beta, -alpha, newDepth, ply+1, infoAfterMove, childKey, true, !pvNode && !cutNode);
+			} else {
+				//late, quiet moves are searched with reduced depth
+				int reduction = 0;
+				if(lmrCandidate) {
+					reduction = lateMoveReduction(depthLeft, movesSearched);
+					if(reduction > 0) ++statistics.lateMoveReductions;
+				}
+				//later moves only need to be proven worse than alpha: null window search
+				evaluation = -alphaBetaNegamax(-alpha-1, -alpha, newDepth - reduction, ply+1, infoAfterMove, childKey, true, true);
+				if(evaluation > alpha && reduction > 0) { //reduced move beat alpha, verify at full depth
+					++statistics.lateMoveResearches;
+					evaluation = -alphaBetaNegamax(-alpha-1, -alpha, newDepth, ply+1, infoAfterMove, childKey, true, !cutNode);
+				}
+				if(evaluation > alpha && evaluation < beta) { //this move may be better than the first, get exact score
+					evaluation = -alphaBetaNegamax(-beta, -alpha, newDepth, ply+1, infoAfterMove, childKey, true, false);
+				}
+			}
+			followPv = false;
+			board.unmakeMove(move, side, capturedPiece); //unmake the move before moving on
+			++movesSearched;
+			if(evaluation > alpha && evaluation < beta) { //new best line, only happens in principal variation nodes
+				principalVariation.update(ply, move);
+			}
+			if(evaluation > bestEvaluation) {
+				bestEvaluation = evaluation;
+				bestMove = move;
+			}
+			if(bestEvaluation > alpha) {
+				alpha = bestEvaluation;
+			}
+			if(bestEvaluation >= beta) {
+				++statistics.cutoffs[std::min(movesSearched - 1, cutoff_histogram_size - 1)];
+				if(quiet) { //remember quiet moves that cause cutoffs
+					ordering.quietCutoff(side, ply, depthLeft, move, previousMove, quiets);
+				}
+				return true;
+			}
+			if(quiet) quiets.push_back(move);
+			return false;
+		};
+		history.push(zobristKey); //the children of this node are searched
+		/*
+		 * The hash move is searched first, before generating the moves. It often causes a cutoff, and then
+		 * the move generation is not needed at all. Keys may collide, so it must be checked for pseudo legality.
+		 */
+		bool hashMoveUsable = !(hashMove == NULLMOVE) && generator.isPseudoLegalMove(side, hashMove)
+				&& isLegalMove(hashMove, board, gameInfo);
+		bool cutoff = hashMoveUsable && searchMove(hashMove);
+		if(!cutoff) {
+			if(!movesGenerated) { //create pseudo legal moves for this board and side
+				generator.generatePseudoLegalMoves(side, moves);
+			}
+			//SORT moves indo descending order based on their move scores (move ordering)
+			ordering.scoreMoves(moves, board, side, ply, previousMove);
+			std::sort(moves.begin(), moves.end(), std::greater<move>());
+			for(const move& move: moves) {
+				if(hashMoveUsable && move == hashMove) continue; //already searched
+				if(seePruningAllowed && movesSearched > 0) { //skip moves that lose too much material near the leaves
+					bool quiet = !move.isCapture() && !move.isPromotion();
+					int margin = quiet ? options.seeQuietMargin : options.seeCaptureMargin;
+					if(!staticExchangeEvaluation(board, move, -margin * depthLeft)) {
+						++statistics.staticExchangePrunes;
+						continue;
+					}
+				}
+				if(!isLegalMove(move, board, gameInfo)) continue; //only evaluate this moves if it is legal
+				if(searchMove(move)) break;
+			}
+		}
+		history.pop();
+		if(control.stop) return 0; //don't store unreliable results
+		if(movesSearched == 0) { //no legal moves: mate or stalemate
+			return isSpecialBoard(side, board, false, ply).evaluation;
+		}
+		//store move in the transposition table
+		unsigned short entryType;
+		if(bestEvaluation <= alphaOriginal) {
+			entryType = upperBound;
+		} else if(bestEvaluation >= beta) {
+			entryType = lowerBound;
+		} else {
+			entryType = exact;
+		}
+		transposition_entry newEntry(zobristKey, entryType, depthLeft, bestEvaluation, staticEvaluation, bestMove);
+		if(ttable.put(zobristKey, newEntry, ply)) {
+			++statistics.ttCollisions; //another position of this search was evicted
+		}
+		return alpha;
+	}
+}
@@ -0,0 +1,348 @@
+/*
+ * search_worker.h
+ */
+
+#ifndef SRC_ENGINE_SEARCH_WORKER_H_
+#define SRC_ENGINE_SEARCH_WORKER_H_
+
+#include <vector>
+#include <string>
+#include <atomic>
+
+#include "board/board.h"
+#include "transposition_table.h"
+#include "move_ordering.h"
+#include "search_statistics.h"
+
+namespace tchess
+{
+	/*
+	 * What the search does in deep nodes where the transposition table has no move to search first:
+	 *  - ignoreNoHashMove: nothing, the moves are searched in their normal order.
+	 *  - internalIterativeDeepening: a reduced depth search of the node finds the move to search first.
+	 *  - internalIterativeReduction: the node is searched with one less depth. Badly ordered nodes are
+	 *  expensive, and if the node is important, then the next iteration will find it with a hash move.
+	 */
+	extern const unsigned int ignoreNoHashMove, internalIterativeDeepening, internalIterativeReduction;
+
+	/*
+	 * Tunable parameters of the search. A default constructed object contains the values
+	 * the engine uses when nothing else is specified.
+	 */
+	struct search_options {
+
+		//Enables null move pruning.
+		bool nullMovePruning;
+
+		//Null move is only tried if at least this much depth is left.
+		int nullMoveMinDepth;
+
+		/*
+		 * When this much (or more) depth is left, a null move cutoff is only accepted after
+		 * a reduced depth normal search also fails high. Guards against zugzwang deep in the tree.
+		 */
+		int nullMoveVerificationDepth;
+
+		//Enables late move reductions.
+		bool lateMoveReductions;
+
+		//Late move reductions are only applied if at least this much depth is left.
+		int lmrMinDepth;
+
+		//This many moves are always searched to full depth in a node, only later ones are reduced.
+		unsigned int lmrFullDepthMoves;
+
+		//Enables ProbCut: cutting nodes where a reduced depth search of a good capture beats beta by a margin.
+		bool probCut;
+
+		//ProbCut is only tried if at least this much depth is left.
+		int probCutMinDepth;
+
+		//The capture must beat beta by this margin.
+		int probCutMargin;
+
+		//Depth reduction of the ProbCut search.
+		int probCutReduction;
+
+		//One of the ignoreNoHashMove, internalIterativeDeepening, internalIterativeReduction constants.
+		unsigned int noHashMoveHandling;
+
+		//Nodes without a hash move are handled if at least this much depth is left.
+		int noHashMoveMinDepth;
+
+		//Depth reduction of the internal iterative deepening search.
+		int iidReduction;
+
+		//Enables searching checking moves one ply deeper (check extension).
+		bool checkExtensions;
+
+		//Moves are only extended closer to the root than this many times the depth of the search.
+		int maxExtensionPlyFactor;
+
+		//Enables skipping moves that lose material (by static exchange evaluation) near the leaves.
+		bool seePruning;
+
+		//Static exchange pruning is only applied if at most this much depth is left.
+		int seePruningMaxDepth;
+
+		//A capture is skipped if it loses more than this margin times the depth left.
+		int seeCaptureMargin;
+
+		//A quiet move is skipped if it loses more than this margin times the depth left.
+		int seeQuietMargin;
+
+		//Enables returning early if the static evaluation is above beta by a margin (reverse futility pruning).
+		bool reverseFutilityPruning;
+
+		//Reverse futility pruning is only applied if at most this much depth is left.
+		int reverseFutilityMaxDepth;
+
+		//The static evaluation must be this much times the depth left above beta.
+		int reverseFutilityMargin;
+
+		//Enables skipping quiet moves if the static evaluation is below alpha by a margin (futility pruning).
+		bool futilityPruning;
+
+		//Futility pruning is only applied if at most this much depth is left.
+		int futilityMaxDepth;
+
+		//The static evaluation must be this much times the depth left below alpha.
+		int futilityMargin;
+
+		//Enables dropping into quiescence search if the static evaluation is far below alpha (razoring).
+		bool razoring;
+
+		//Razoring is only applied if at most this much depth is left.
+		int razoringMaxDepth;
+
+		//The static evaluation must be this much times the depth left below alpha.
+		int razoringMargin;
+
+		/*
+		 * Enables pondering: after making its move, the engine searches the expected reply of the
+		 * opponent (from the principal variation) on a background thread, while the opponent thinks.
+		 */
+		bool ponder;
+
+		//The search stops after this many nodes, 0 means no limit.
+		unsigned long long nodeLimit;
+
+		//The search stops after this many milliseconds, 0 means no limit.
+		unsigned int timeLimit;
+
+		//The limits are checked after every this many nodes, 0 is treated as 1.
+		unsigned int limitCheckInterval;
+
+		//Amount of threads searching the root moves in parallel in the multi-PV analysis, and clearing the transposition table.
+		unsigned int threads;
+
+		//Size of the transposition table in megabytes.
+		unsigned int hashSize;
+
+		//Path of the polyglot opening book file.
+		std::string openingBook;
+
+		/*
+		 * If not empty, the engine loads the transposition table from this file when it is created (if the file
+		 * exists), and saves the table into it when it is destroyed, so that the next run starts with what this one learned.
+		 */
+		std::string hashFile;
+
+		//Prefetches the transposition table bucket of a child node right after its move is made.
+		bool ttPrefetch;
+
+		//Measures the time of every transposition table probe, see search_statistics::ttProbeNanoseconds. Slows down the search.
+		bool measureProbeTime;
+
+		//Prints the statistics of the search after every move.
+		bool printStatistics;
+
+		//If not empty, the statistics of every search are appended to this file, as one JSON object per line.
+		std::string statisticsFile;
+
+		search_options() : nullMovePruning(true), nullMoveMinDepth(3), nullMoveVerificationDepth(8),
+				lateMoveReductions(true), lmrMinDepth(3), lmrFullDepthMoves(3),
+				probCut(true), probCutMinDepth(5), probCutMargin(200), probCutReduction(4),
+				noHashMoveHandling(internalIterativeReduction), noHashMoveMinDepth(4), iidReduction(2),
+				checkExtensions(true), maxExtensionPlyFactor(2),
+				seePruning(true), seePruningMaxDepth(3), seeCaptureMargin(100), seeQuietMargin(60),
+				reverseFutilityPruning(true), reverseFutilityMaxDepth(3), reverseFutilityMargin(120),
+				futilityPruning(true), futilityMaxDepth(3), futilityMargin(150),
+				razoring(true), razoringMaxDepth(2), razoringMargin(300), ponder(false),
+				nodeLimit(0), timeLimit(0), limitCheckInterval(2048), threads(1), hashSize(def_hash_size), openingBook(def_opening_book),
+				ttPrefetch(true), measureProbeTime(false), printStatistics(false) {}
+
+		//The limit check interval, at least 1 so that the countdown to the next check can't underflow.
+		unsigned int limitCheckNodes() const {
+			return limitCheckInterval > 0 ? limitCheckInterval : 1;
+		}
+	};
+
+	/*
+	 * Signals of a search that are shared by all of its threads.
+	 */
+	struct search_control {
+
+		/*
+		 * Set to stop the running search as soon as possible. The search unwinds without storing anything,
+		 * and the best move of the last completed iteration is used. It is only cleared when a search finishes,
+		 * so a stop requested right before a search starts stops that search.
+		 */
+		std::atomic<bool> stop;
+
+		//When the time limit runs out, in steady clock nanoseconds. 0 if there is no time limit.
+		std::atomic<long long> deadline;
+
+		//True while the ponder search runs, the search prints nothing and has no limits then.
+		std::atomic<bool> pondering;
+
+		//Nodes searched by all threads, the node limit is checked against this.
+		std::atomic<unsigned long long> nodes;
+
+		search_control() : stop(false), deadline(0), pondering(false), nodes(0) {}
+	};
+
+	/*
+	 * Searches the moves of the root position on one thread. Owns everything that changes during the search
+	 * (board, heuristics, principal variation, statistics), the transposition table and the stop signals
+	 * are shared with the other workers of the same search.
+	 */
+	class search_worker {
+
+		//Parameters of the search.
+		const search_options& options;
+
+		//The transposition table, shared by all workers.
+		transposition_table& ttable;
+
+		//Stop flag and limits, shared by all workers.
+		search_control& control;
+
+		//Board of the search, moves are made and unmade on it.
+		chessboard board;
+
+		//Game information of the root position.
+		game_information info;
+
+		//Hash keys of the positions of the game, followed by the positions on the current search path.
+		position_history history;
+
+		//Killer, history and countermove tables that order the quiet moves.
+		move_ordering_heuristics ordering;
+
+		//The moves made on the current search path, the move at index i was made at ply i (NULLMOVE for null moves).
+		move pathMoves[max_search_ply];
+
+		//Quiet moves searched at each ply, without causing a cutoff. Kept here to reuse the memory.
+		std::vector<move> quietsTried[max_search_ply];
+
+		//Counters of this worker.
+		search_statistics statistics;
+
+		//Principal variation of the last searched root move.
+		principal_variation principalVariation;
+
+		//Principal variation of the previous iteration, its moves are searched first.
+		std::vector<move> previousPv;
+
+		//True while the search is on the path of the previous principal variation.
+		bool followPv;
+
+		//Depth of the root move search, limits the extensions.
+		int rootDepth;
+
+		//Nodes left until the limits are checked again.
+		unsigned int nodesUntilLimitCheck;
+
+		//Nodes of this worker already added to the shared node count.
+		unsigned long long nodesReported;
+
+	public:
+		search_worker(const search_options& options, transposition_table& ttable, search_control& control)
+			: options(options), ttable(ttable), control(control), followPv(false), rootDepth(0),
+			  nodesUntilLimitCheck(options.limitCheckNodes()), nodesReported(0) {}
+
+		/*
+		 * Sets the root position of the next search. The history must contain the root position as the last key.
+		 */
+		void setPosition(const chessboard& rootBoard, const game_information& rootInfo, const position_history& rootHistory);
+
+		/*
+		 * Prepares a new search: clears the statistics, the principal variation and ages the move ordering heuristics.
+		 */
+		void newSearch();
+
+		/*
+		 * Scores and sorts the legal root moves. The given move (if found) is placed first.
+		 */
+		void orderRootMoves(std::vector<move>& moves, const move& firstMove);
+
+		/*
+		 * Sets the line that is searched first in the next root move search.
+		 */
+		void setPreviousPv(const std::vector<move>& pv) {
+			previousPv = pv;
+		}
+
+		/*
+		 * Searches a legal root move with the given window and remaining depth, the score is from the
+		 * view of the side to move at the root. If the score is inside the window, then the line of the
+		 * move is available from getLine. The result is not reliable if the search was stopped meanwhile.
+		 */
+		int searchRootMove(const move& rootMove, int alpha, int beta, int depthLeft);
+
+		/*
+		 * The principal variation of the last searched root move, starting with the root move.
+		 */
+		std::vector<move> getLine() const {
+			return principalVariation.getLine();
+		}
+
+		const search_statistics& getStatistics() const {
+			return statistics;
+		}
+
+	private:
+		/*
+		 * Negamax tree searching method with alpha-beta cutoff.
+		 * - depth left: Current search depth. If this is 0, then we dont go deeper and evaluate.
+		 * - ply: distance from the root. Not the same as depth - depthLeft, since depth may be reduced.
+		 * - game info: the non-reversible elements of the board. These are copy made and passed in.
+		 * - zobrist key: hash of the position, updated incrementally by the parent.
+		 * - null move allowed: false right after a null move, so that two null moves never follow each other.
+		 * - cut node: a null window node that is expected to fail high. The other null window nodes are
+		 *   expected to fail low (all nodes), where every move is searched anyway.
+		 */
+		int alphaBetaNegamax(int alpha, int beta, int depthLeft, unsigned int ply, game_information& gameInfo, uint64 zobristKey,
+				bool nullMoveAllowed, bool cutNode);
+
+		/*
+		 * Quiescence search, called when the depth runs out. Only captures (and queen promotions) are searched
+		 * until the position is quiet, so that the static evaluation is not done in the middle of an exchange.
+		 * The side to move may also "stand pat": accept the static evaluation instead of capturing. Captures
+		 * losing material by static exchange evaluation are not searched.
+		 */
+		int quiescence(int alpha, int beta, unsigned int ply, game_information& gameInfo);
+
+		/*
+		 * Null move pruning: the side to move passes, and if a reduced depth search still
+		 * fails high, then the node is most likely a cut node. Returns true if the node can
+		 * be cut, and the score to return is placed into 'score'.
+		 */
+		bool nullMoveCutoff(int beta, int depthLeft, unsigned int ply, game_information& gameInfo, uint64 zobristKey, int& score);
+
+		/*
+		 * Called after every few nodes: adds the nodes of this worker to the shared count, and sets
+		 * the stop flag if the node or time limit is reached.
+		 */
+		void checkLimits();
+
+		/*
+		 * Returns how much the depth of a late move is reduced, based on the remaining depth and
+		 * the index of the move in the ordered move list.
+		 */
+		int lateMoveReduction(int depthLeft, unsigned int moveIndex) const;
+	};
+}
+
+#endif /* SRC_ENGINE_SEARCH_WORKER_H_ */
@@ -5,40 +5,57 @@
  *      Author: Gspr Tams
  */
 
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "transposition_table.h"
+#include "board/evaluation.h"
 
 namespace tchess
 {
-	uint64 createZobrishHash(const chessboard& board, const game_information& info) {
-		uint64 boardKey = 0;
-		unsigned int rank = 0, file = 0;
-		//iterate board and find pieces
-		for(unsigned int square = 0; square < 64; ++square) {
-			if(board[square] != 0) { //piece found
-				unsigned int polyPiece = polyPieceCode(board[square]); //get polyglot piece code
-				//find rank and board of square
-				file = square % 8;
-				rank = 7 - square / 8;
-				//"add" piece to polyglot key
-				boardKey ^= Random64[(64 * polyPiece) + (8 * rank) + file];
-			}
-		}
-		//add castling rights to board key
-		int offset = 768;
+	//Random number of a piece on a square.
+	static inline uint64 pieceKey(int piece, unsigned int square) {
+		unsigned int file = square % 8;
+		unsigned int rank = 7 - square / 8;
+		return Random64[(64 * polyPieceCode(piece)) + (8 * rank) + file];
+	}
+
+	//The part of the key that comes from the castling rights.
+	static uint64 castlingKey(const game_information& info) {
+		const int offset = 768;
+		uint64 key = 0;
 		if(info.getKingsideCastleRights(white)) {
-			boardKey ^= Random64[offset];
+			key ^= Random64[offset];
 		}
 		if(info.getQueensideCastleRights(white)) {
-			boardKey ^= Random64[offset + 1];
+			key ^= Random64[offset + 1];
 		}
 		if(info.getKingsideCastleRights(black)) {
-			boardKey ^= Random64[offset + 2];
+			key ^= Random64[offset + 2];
 		}
 		if(info.getQueensideCastleRights(black)) {
-			boardKey ^= Random64[offset + 3];
+			key ^= Random64[offset + 3];
 		}
-		//add en passant sqaure to board key
-		offset = 772;
+		return key;
+	}
+
+	//The part of the key that comes from the en passant square.
+	static uint64 enPassantKey(const game_information& info) {
+		const int offset = 772;
 		int whiteEnPassantSquare = info.getEnPassantSquare(white);
 		int blackEnPassantSquare = info.getEnPassantSquare(black);
 		int enPassantSquare = noEnPassant;
@@ -49,16 +66,56 @@ namespace tchess
 		}
 		if(enPassantSquare != noEnPassant) {
 			unsigned int enPassantFile = enPassantSquare % 8;
-			boardKey ^= Random64[offset + enPassantFile];
+			return Random64[offset + enPassantFile];
+		}
+		return 0;
+	}
+
+	//Random number of black to move.
+	static const unsigned int sideToMoveOffset = 780;
+
+	uint64 createZobrishHash(const chessboard& board, const game_information& info) {
+		uint64 boardKey = 0;
+		//iterate board and find pieces, "add" them to polyglot key
+		for(unsigned int square = 0; square < 64; ++square) {
+			if(board[square] != 0) { //piece found
+				boardKey ^= pieceKey(board[square], square);
+			}
 		}
+		//add castling rights and en passant square to board key
+		boardKey ^= castlingKey(info);
+		boardKey ^= enPassantKey(info);
 		//add side to move to key
-		offset = 780;
 		if(info.getSideToMove() == black) {
-			boardKey ^= Random64[offset];
+			boardKey ^= Random64[sideToMoveOffset];
 		}
 		return boardKey;
 	}
 
+	uint64 updateZobrishHash(uint64 key, const chessboard& board, const move& m, unsigned int side, int capturedPiece,
+			const game_information& infoBefore, const game_information& infoAfter) {
+		const unsigned int from = m.getFromSquare(), to = m.getToSquare();
+		const int ownPawn = side == white ? pawn : -pawn, ownRook = side == white ? rook : -rook;
+		const int pieceThatMoved = m.isPromotion() ? ownPawn : board[to];
+		key ^= pieceKey(pieceThatMoved, from) ^ pieceKey(board[to], to); //a promoted piece arrives on the destination
+		if(m.isKingsideCastle()) { //the rook also moved
+			key ^= pieceKey(ownRook, to + 1) ^ pieceKey(ownRook, from + 1);
+		} else if(m.isQueensideCastle()) {
+			key ^= pieceKey(ownRook, to - 2) ^ pieceKey(ownRook, from - 1);
+		} else if(m.isEnPassant()) { //the captured pawn is not on the destination square
+			key ^= pieceKey(capturedPiece, side == white ? to+8 : to-8);
+		} else if(capturedPiece != 0) {
+			key ^= pieceKey(capturedPiece, to);
+		}
+		key ^= castlingKey(infoBefore) ^ castlingKey(infoAfter);
+		key ^= enPassantKey(infoBefore) ^ enPassantKey(infoAfter);
+		return key ^ Random64[sideToMoveOffset];
+	}
+
+	uint64 updateZobrishHashNullMove(uint64 key, const game_information& infoBefore, const game_information& infoAfter) {
+		return key ^ enPassantKey(infoBefore) ^ enPassantKey(infoAfter) ^ Random64[sideToMoveOffset];
+	}
+
 	const unsigned short exact = 1;
 	const unsigned short upperBound = 2;
 	const unsigned short lowerBound = 3;
@@ -66,8 +123,347 @@ namespace tchess
 
 	const transposition_entry EMPTY_ENTRY = transposition_entry();
 
-	const unsigned int def_transposition_table_size = 256000000 / sizeof(transposition_entry);
-}
+	const int no_static_evaluation = INT32_MIN;
 
+	//Static evaluation in the packed entries, when it is not known.
+	static const short tt_no_static_evaluation = INT16_MIN;
 
+	/*
+	 * Mate scores in the table: the score of being mated in 0 plies from the position is -tt_mate_score, and
+	 * the score of mating in 0 plies is tt_mate_score. Every other score is clamped below tt_max_normal_score.
+	 */
+	static const int tt_mate_score = 32000;
 
+	static const int tt_mate_range = 1000;
+
+	static const int tt_max_normal_score = tt_mate_score - tt_mate_range - 1;
+
+	const unsigned int def_hash_size = 256;
+
+	//The table is aligned to this, and its size is rounded up to it: the size of a huge page on x86-64.
+	static const size_t huge_page_size = 2 * 1024 * 1024;
+
+	static_assert(sizeof(tt_bucket) == 64, "a bucket must fill exactly one cache line");
+
+	static_assert(std::atomic<uint64>::is_always_lock_free, "the slots of the table must be lock free");
+
+	/*
+	 * Converts a search score to the 16 bit score of the table. Mate scores of the search count the plies
+	 * from the root, but the position may be reached on another ply later: they are stored relative to the position.
+	 */
+	static short scoreToTable(int score, unsigned int ply) {
+		if(isMateScore(score)) {
+			if(score < 0) { //mated: score is WORST_VALUE + the ply of the mate
+				int distance = score - WORST_VALUE - ply;
+				return (short)(-tt_mate_score + std::min(distance, tt_mate_range));
+			} else { //mating: score is -(WORST_VALUE + the ply of the mate)
+				int distance = -(score + WORST_VALUE) - ply;
+				return (short)(tt_mate_score - std::min(distance, tt_mate_range));
+			}
+		}
+		return (short)std::max(-tt_max_normal_score, std::min(score, tt_max_normal_score));
+	}
+
+	//Inverse of scoreToTable.
+	static int scoreFromTable(short tableScore, unsigned int ply) {
+		if(tableScore <= -tt_mate_score + tt_mate_range) {
+			return WORST_VALUE + (int)ply + (tableScore + tt_mate_score);
+		} else if(tableScore >= tt_mate_score - tt_mate_range) {
+			return -(WORST_VALUE + (int)ply + (tt_mate_score - tableScore));
+		}
+		return tableScore;
+	}
+
+	static short evaluationToTable(int staticEvaluation) {
+		if(staticEvaluation == no_static_evaluation) return tt_no_static_evaluation;
+		return (short)std::max(-tt_max_normal_score, std::min(staticEvaluation, tt_max_normal_score));
+	}
+
+	/*
+	 * Allocates the given amount of bytes (a multiple of the huge page size) aligned to a huge page. On
+	 * Linux the kernel is asked to back it with transparent huge pages, elsewhere normal pages are used.
+	 */
+	static tt_bucket* allocateBuckets(size_t bytes) {
+#ifdef _WIN32
+		void* memory = _aligned_malloc(bytes, huge_page_size);
+#else
+		void* memory = std::aligned_alloc(huge_page_size, bytes);
+#endif
+		if(memory == nullptr) throw std::bad_alloc();
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+		madvise(memory, bytes, MADV_HUGEPAGE); //only a hint, the table works without huge pages too
+#endif
+		return static_cast<tt_bucket*>(memory);
+	}
+
+	//Length of the allocation holding a table of the given bytes: aligned_alloc needs a multiple of the alignment.
+	static size_t allocationBytes(size_t tableBytes) {
+		return (tableBytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+	}
+
+	static void freeBuckets(tt_bucket* buckets) {
+#ifdef _WIN32
+		_aligned_free(buckets);
+#else
+		std::free(buckets);
+#endif
+	}
+
+	transposition_table::transposition_table(unsigned int megabytes, unsigned int threads, bool allocate)
+		: size(0), buckets(nullptr), allocatedBytes(0), fileMapping(nullptr), fileMappingBytes(0), generation(0) {
+		if(allocate) resize(megabytes, threads);
+	}
+
+	transposition_table::~transposition_table() {
+		release();
+	}
+
+	void transposition_table::release() {
+		if(fileMapping != nullptr) {
+#ifndef _WIN32
+			munmap(fileMapping, fileMappingBytes);
+#endif
+		} else {
+			freeBuckets(buckets);
+		}
+		buckets = nullptr;
+		size = 0;
+		allocatedBytes = 0;
+		fileMapping = nullptr;
+		fileMappingBytes = 0;
+	}
+
+	void transposition_table::resize(unsigned int megabytes, unsigned int threads) {
+		//only the allocation is rounded up, the table uses exactly the requested size
+		const size_t tableBytes = std::max((size_t)megabytes, (size_t)1) << 20;
+		const size_t bytes = allocationBytes(tableBytes);
+		if(bytes != allocatedBytes) {
+			release();
+			buckets = allocateBuckets(bytes);
+			allocatedBytes = bytes;
+		}
+		size = (unsigned int)(tableBytes / sizeof(tt_bucket));
+		clear(threads);
+	}
+
+	/*
+	 * Header of a saved table. The buckets follow it at tt_file_header_size, so that they stay aligned
+	 * to a page in the mapped file. A table can only be loaded by a program that stores the entries in
+	 * the same way, and creates the same hash keys.
+	 */
+	struct tt_file_header {
+
+		//tt_file_magic
+		char magic[8];
+
+		//Changes when the layout of the entries or the bucket indexing changes.
+		unsigned int version;
+
+		//tt_file_byte_order as written by the saving machine.
+		unsigned int byteOrder;
+
+		//Size of a bucket in bytes, and the amount of slots in it.
+		unsigned int bucketBytes;
+		unsigned int slotsInBucket;
+
+		//Amount of buckets in the file.
+		unsigned int bucketCount;
+
+		//Generation of the table when it was saved.
+		unsigned int generation;
+
+		//Identifies the random numbers of the hash keys, see keyScheme.
+		uint64 keyScheme;
+	};
+
+	static const char tt_file_magic[8] = {'T', 'C', 'H', 'E', 'S', 'S', 'T', 'T'};
+
+	static const unsigned int tt_file_version = 1;
+
+	static const unsigned int tt_file_byte_order = 0x01020304;
+
+	static const size_t tt_file_header_size = 4096;
+
+	//Combines the random numbers of the hash keys into one number.
+	static uint64 keyScheme() {
+		uint64 scheme = 0;
+		for(unsigned int i = 0; i < 781; ++i) {
+			scheme = (scheme ^ Random64[i]) * 0x100000001B3ULL;
+		}
+		return scheme;
+	}
+
+	//Header that a table of this program would have with the given size and generation.
+	static tt_file_header createFileHeader(unsigned int bucketCount, unsigned int generation) {
+		tt_file_header header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, tt_file_magic, sizeof(tt_file_magic));
+		header.version = tt_file_version;
+		header.byteOrder = tt_file_byte_order;
+		header.bucketBytes = sizeof(tt_bucket);
+		header.slotsInBucket = bucket_size;
+		header.bucketCount = bucketCount;
+		header.generation = generation;
+		header.keyScheme = keyScheme();
+		return header;
+	}
+
+	void transposition_table::save(const std::string& path) const {
+		/*
+		 * Written into a temporary file first, then renamed: the table may be mapped from the file
+		 * that is replaced, and the mapping keeps using the old file.
+		 */
+		const std::string temporaryPath = path + ".tmp";
+		FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+		if(file == nullptr) {
+			throw std::runtime_error("Can't create transposition table file: " + temporaryPath);
+		}
+		char headerBlock[tt_file_header_size] = {};
+		tt_file_header header = createFileHeader(size, generation);
+		std::memcpy(headerBlock, &header, sizeof(header));
+		bool written = std::fwrite(headerBlock, 1, tt_file_header_size, file) == tt_file_header_size
+				&& std::fwrite(static_cast<const void*>(buckets), sizeof(tt_bucket), size, file) == size;
+		if(std::fclose(file) != 0 || !written) {
+			std::remove(temporaryPath.c_str());
+			throw std::runtime_error("Can't write transposition table file: " + temporaryPath);
+		}
+#ifdef _WIN32
+		std::remove(path.c_str()); //rename does not replace an existing file on Windows
+#endif
+		if(std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+			std::remove(temporaryPath.c_str());
+			throw std::runtime_error("Can't replace transposition table file: " + path);
+		}
+	}
+
+	bool transposition_table::load(const std::string& path) {
+		FILE* file = std::fopen(path.c_str(), "rb");
+		if(file == nullptr) return false; //no saved table yet
+		tt_file_header header;
+		bool headerRead = std::fread(&header, sizeof(header), 1, file) == 1;
+		std::fseek(file, 0, SEEK_END);
+		long fileBytes = std::ftell(file);
+		tt_file_header expected = createFileHeader(header.bucketCount, header.generation);
+		if(!headerRead || std::memcmp(&header, &expected, sizeof(header)) != 0 || header.bucketCount == 0
+				|| fileBytes != (long)(tt_file_header_size + (size_t)header.bucketCount * sizeof(tt_bucket))) {
+			std::fclose(file);
+			return false; //saved by a different version, or not a table at all
+		}
+#ifdef _WIN32
+		//no mapping, the buckets are read into the memory
+		const size_t bytes = allocationBytes((size_t)header.bucketCount * sizeof(tt_bucket));
+		tt_bucket* loadedBuckets = allocateBuckets(bytes);
+		std::memset(static_cast<void*>(loadedBuckets), 0, bytes);
+		std::fseek(file, (long)tt_file_header_size, SEEK_SET);
+		bool read = std::fread(static_cast<void*>(loadedBuckets), sizeof(tt_bucket), header.bucketCount, file) == header.bucketCount;
+		std::fclose(file);
+		if(!read) {
+			freeBuckets(loadedBuckets);
+			throw std::runtime_error("Can't read transposition table file: " + path);
+		}
+		release();
+		buckets = loadedBuckets;
+		allocatedBytes = bytes;
+#else
+		std::fclose(file);
+		int descriptor = open(path.c_str(), O_RDONLY);
+		void* mapping = descriptor < 0 ? MAP_FAILED : mmap(nullptr, (size_t)fileBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+		if(descriptor >= 0) close(descriptor); //the mapping keeps the file open
+		if(mapping == MAP_FAILED) {
+			throw std::runtime_error("Can't map transposition table file: " + path);
+		}
+		release();
+		fileMapping = mapping;
+		fileMappingBytes = (size_t)fileBytes;
+		buckets = reinterpret_cast<tt_bucket*>(static_cast<char*>(mapping) + tt_file_header_size);
+#endif
+		size = header.bucketCount;
+		generation = (unsigned char)header.generation;
+		return true;
+	}
+
+	void transposition_table::clear(unsigned int threads) {
+		//writing the memory also makes the operating system map the pages now, and not during the search
+		threads = std::max(1u, std::min(threads, size));
+		const unsigned int bucketsPerThread = (size + threads - 1) / threads;
+		auto clearRange = [this, bucketsPerThread](unsigned int index) {
+			unsigned int first = index * bucketsPerThread;
+			unsigned int last = std::min(size, first + bucketsPerThread);
+			if(first < last) std::memset(static_cast<void*>(buckets + first), 0, (size_t)(last - first) * sizeof(tt_bucket));
+		};
+		std::vector<std::thread> clearThreads;
+		for(unsigned int i = 1; i < threads; ++i) {
+			clearThreads.emplace_back(clearRange, i);
+		}
+		clearRange(0);
+		for(std::thread& thread: clearThreads) {
+			thread.join();
+		}
+		generation = 0;
+	}
+
+	bool transposition_table::find(uint64 key, transposition_entry& entry, unsigned int ply) const {
+		const tt_bucket& bucket = buckets[bucketIndex(key)];
+		const unsigned int keyFragment = (unsigned int)key;
+		for(unsigned int i = 0; i < bucket_size; ++i) {
+			const packed_entry slot = bucket.load(i); //a copy, other threads may write the slot meanwhile
+			if(!slot.isEmpty() && slot.keyFragment == keyFragment) {
+				int staticEvaluation = slot.staticEvaluation == tt_no_static_evaluation ? no_static_evaluation : slot.staticEvaluation;
+				entry = transposition_entry(key, slot.getEntryType(), slot.depth, scoreFromTable(slot.score, ply),
+						staticEvaluation, unpackMove(slot.bestMove));
+				entry.generation = slot.getGeneration();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool transposition_table::put(uint64 key, const transposition_entry& entry, unsigned int ply) {
+		tt_bucket& bucket = buckets[bucketIndex(key)];
+		const unsigned int keyFragment = (unsigned int)key;
+		packed_entry slots[bucket_size];
+		for(unsigned int i = 0; i < bucket_size; ++i) {
+			slots[i] = bucket.load(i);
+		}
+		int target = -1;
+		for(unsigned int i = 0; i < bucket_size; ++i) {
+			if(!slots[i].isEmpty() && slots[i].keyFragment == keyFragment) { //same position
+				if(!replaceOldEntry(slots[i], entry)) return false;
+				target = i;
+				break;
+			}
+		}
+		bool collision = false;
+		if(target == -1) { //an empty slot, or the least valuable one
+			for(unsigned int i = 0; i < bucket_size; ++i) {
+				if(slots[i].isEmpty()) {
+					target = i;
+					break;
+				}
+				if(target == -1 || entryValue(slots[i]) < entryValue(slots[target])) target = i;
+			}
+			collision = !slots[target].isEmpty() && slots[target].getGeneration() == generation;
+		}
+		packed_entry newSlot;
+		newSlot.keyFragment = keyFragment;
+		newSlot.bestMove = entry.bestMove.pack();
+		newSlot.score = scoreToTable(entry.score, ply);
+		newSlot.staticEvaluation = evaluationToTable(entry.staticEvaluation);
+		newSlot.depth = (unsigned char)std::min(entry.depth, 255u);
+		newSlot.generationAndType = (unsigned char)((generation << 2) | entry.entryType);
+		bucket.store(target, newSlot);
+		return collision;
+	}
+
+	double transposition_table::occupancy() const {
+		const unsigned int sampledBuckets = std::min(size, 1000u);
+		unsigned int used = 0;
+		for(unsigned int i = 0; i < sampledBuckets; ++i) {
+			for(unsigned int j = 0; j < bucket_size; ++j) {
+				const packed_entry slot = buckets[i].load(j);
+				if(!slot.isEmpty() && slot.getGeneration() == generation) ++used;
+			}
+		}
+		return sampledBuckets == 0 ? 0 : (double)used / (sampledBuckets * bucket_size);
+	}
+}
@@ -10,8 +10,12 @@
 
 #include <utility>
 #include <array>
+#include <vector>
+#include <atomic>
+#include <string>
 
 #include "polyglot.h" //<- for the 781 random numbers and uint typedef
+#include "board/position_history.h"
 
 namespace tchess
 {
@@ -20,12 +24,29 @@ namespace tchess
 	 */
 	uint64 createZobrishHash(const chessboard& board, const game_information& info);
 
+	/*
+	 * Computes the hash of the position after a move from the hash of the position before it, without
+	 * iterating the board. The board is the one after the move, captured piece is what makeMove returned.
+	 * The game information objects are the ones before and after the move.
+	 */
+	uint64 updateZobrishHash(uint64 key, const chessboard& board, const move& m, unsigned int side, int capturedPiece,
+			const game_information& infoBefore, const game_information& infoAfter);
+
+	/*
+	 * Computes the hash of the position after a null move (only the side to move and the en passant square change).
+	 */
+	uint64 updateZobrishHashNullMove(uint64 key, const game_information& infoBefore, const game_information& infoAfter);
+
+
 	/*
 	 * Constants for the 3 types of entries in the transposition table. Extra type is
 	 * for
 	 */
 	extern const unsigned short exact, upperBound, lowerBound, uninitialized;
 
+	//Static evaluation of entries where it was not computed.
+	extern const int no_static_evaluation;
+
 	/*
 	 * Represents an entry in the transposition table.
 	 */
@@ -46,11 +67,14 @@ namespace tchess
 		 */
 		int score;
 
+		//Static evaluation of the position, or no_static_evaluation if the search didn't need it.
+		int staticEvaluation;
+
 		/*
-		 * This flag determines how the entry can be replaced. If the entry
-		 * is useful it will not be replaced.
+		 * Generation of the table (counter of the searches) when the entry was stored. Entries
+		 * of earlier searches are replaced more easily.
 		 */
-		bool usefulEntry;
+		unsigned char generation;
 
 		/*
 		 * The best move at this position.
@@ -60,15 +84,17 @@ namespace tchess
 		/*
 		 * Creates an uninitialized entry.
 		 */
-		transposition_entry() : hashKey(0), entryType(uninitialized), depth(0), score(0), usefulEntry(false), bestMove(NULLMOVE) {}
+		transposition_entry() : hashKey(0), entryType(uninitialized), depth(0), score(0), staticEvaluation(no_static_evaluation),
+				generation(0), bestMove(NULLMOVE) {}
 
-		//constructor from values
-		transposition_entry(uint64 hashKey, unsigned short entryType, unsigned int depth, int score, bool useful, const move& m)
-			: hashKey(hashKey), entryType(entryType), depth(depth), score(score), usefulEntry(useful), bestMove(m) {}
+		//constructor from values, the generation is set by the table
+		transposition_entry(uint64 hashKey, unsigned short entryType, unsigned int depth, int score, int staticEvaluation, const move& m)
+			: hashKey(hashKey), entryType(entryType), depth(depth), score(score), staticEvaluation(staticEvaluation),
+			  generation(0), bestMove(m) {}
 
 		//Copy constructor.
 		transposition_entry(const transposition_entry& other) : hashKey(other.hashKey), entryType(other.entryType), depth(other.depth),
-				score(other.score), usefulEntry(other.usefulEntry), bestMove(other.bestMove) {}
+				score(other.score), staticEvaluation(other.staticEvaluation), generation(other.generation), bestMove(other.bestMove) {}
 
 		//Assignment operator.
 		void operator=(const transposition_entry& other) {
@@ -76,13 +102,14 @@ namespace tchess
 			entryType = other.entryType;
 			depth = other.depth;
 			score = other.score;
-			usefulEntry = other.usefulEntry;
+			staticEvaluation = other.staticEvaluation;
+			generation = other.generation;
 			bestMove = other.bestMove;
 		}
 
 		bool operator==(const transposition_entry& other) {
 			return hashKey == other.hashKey && entryType == other.entryType && depth == other.depth &&
-					score == other.score && usefulEntry == other.usefulEntry && bestMove == other.bestMove;
+					score == other.score && staticEvaluation == other.staticEvaluation && generation == other.generation && bestMove == other.bestMove;
 		}
 
 		bool operator!=(const transposition_entry& other) {
@@ -96,86 +123,261 @@ namespace tchess
 	extern const transposition_entry EMPTY_ENTRY;
 
 	/*
-	 * The amount of entries in the transposition table. Determined by how many entries can
-	 * fit in 256 MB.
+	 * The form in which the entries are stored in the table, 12 bytes. Only the lower 32 bits of the hash
+	 * key are stored: the upper bits already selected the bucket. Scores are stored on 16 bits, mate scores
+	 * are converted to be relative to the position (not the root), see scoreToTable. The table stores the
+	 * fields after the key fragment as one 64 bit data word, see toData.
 	 */
-	extern const unsigned int def_transposition_table_size;
+	struct packed_entry {
+
+		//Lower 32 bits of the hash key.
+		unsigned int keyFragment;
+
+		//The best move, see move::pack.
+		unsigned short bestMove;
+
+		short score;
+
+		//Static evaluation, tt_no_static_evaluation if not known.
+		short staticEvaluation;
+
+		unsigned char depth;
+
+		//Generation on the upper 6 bits, the entry type (exact, upperBound, lowerBound) on the lower 2. 0 means empty slot.
+		unsigned char generationAndType;
+
+		inline bool isEmpty() const {
+			return (generationAndType & 3) == 0;
+		}
+
+		inline unsigned int getEntryType() const {
+			return generationAndType & 3;
+		}
+
+		inline unsigned int getGeneration() const {
+			return generationAndType >> 2;
+		}
+
+		//The fields except the key fragment in one word. An empty slot has 0 data.
+		inline uint64 toData() const {
+			return (uint64)bestMove | (uint64)(unsigned short)score << 16 | (uint64)(unsigned short)staticEvaluation << 32
+					| (uint64)depth << 48 | (uint64)generationAndType << 56;
+		}
+
+		//Inverse of toData.
+		static inline packed_entry fromData(unsigned int keyFragment, uint64 data) {
+			return packed_entry{keyFragment, (unsigned short)data, (short)(unsigned short)(data >> 16),
+				(short)(unsigned short)(data >> 32), (unsigned char)(data >> 48), (unsigned char)(data >> 56)};
+		}
+	};
+
+	//Amount of entries in a bucket.
+	const unsigned int bucket_size = 5;
+
+	/*
+	 * Entries of the table are grouped into buckets that fill exactly one cache line. A key
+	 * may be stored in any slot of its bucket, so a probe reads only one cache line.
+	 *
+	 * The table is shared by the search threads without locks. A slot is two atomic words: the data of the
+	 * entry, and its check, which is the key fragment XOR the two halves of the data. A reader accepts the
+	 * slot only if the check it read matches the data it read, so an entry torn by a concurrent write looks like
+	 * a different position and is ignored, instead of giving a wrong move or score.
+	 */
+	struct alignas(64) tt_bucket {
+
+		//Data words of the slots, see packed_entry::toData.
+		std::atomic<uint64> data[bucket_size];
+
+		//Check words of the slots.
+		std::atomic<unsigned int> checks[bucket_size];
+
+		//Check word of a key fragment and data.
+		static inline unsigned int check(unsigned int keyFragment, uint64 data) {
+			return keyFragment ^ (unsigned int)data ^ (unsigned int)(data >> 32);
+		}
+
+		/*
+		 * Copies the slot, its key fragment is restored from the check. Relaxed loads are enough, a
+		 * torn slot is detected by its check, the caller compares the key fragment anyway.
+		 */
+		inline packed_entry load(unsigned int slot) const {
+			uint64 slotData = data[slot].load(std::memory_order_relaxed);
+			unsigned int slotCheck = checks[slot].load(std::memory_order_relaxed);
+			return packed_entry::fromData(slotCheck ^ (unsigned int)slotData ^ (unsigned int)(slotData >> 32), slotData);
+		}
+
+		inline void store(unsigned int slot, const packed_entry& entry) {
+			uint64 entryData = entry.toData();
+			data[slot].store(entryData, std::memory_order_relaxed);
+			checks[slot].store(check(entry.keyFragment, entryData), std::memory_order_relaxed);
+		}
+	};
+
+	/*
+	 * Default size of the transposition table in megabytes.
+	 */
+	extern const unsigned int def_hash_size;
 
 	/*
 	 * Transposition table implementation, that is a fixed size hash map. Sadly unordered_map is
-	 * not good, because it can't have a fixed size.
-	 * - Key: must be a type for which mod operator is defined.
+	 * not good, because it can't have a fixed size. The key selects a bucket, and the position
+	 * can be in any slot of the bucket. The buckets are allocated aligned to 2 MB, so that the
+	 * operating system can back the table with huge pages (less TLB misses during the search).
 	 */
 	class transposition_table {
 
 		/*
-		 * Transposition table size.
+		 * Amount of buckets.
+		 */
+		unsigned int size;
+
+		/*
+		 * Bucket array with fixed size, an empty slot is all zero. Shared by the search threads, see tt_bucket.
 		 */
-		const unsigned int size;
+		tt_bucket* buckets;
 
 		/*
-		 * Entry array with fixed size. Each entry is "initialized" to have uninitialized type.
+		 * Size of the allocated bucket array in bytes, the table size rounded up to a multiple of the huge page size
+		 * (the buckets after size are not used). 0 if the buckets are in a file mapping.
 		 */
-		std::vector<transposition_entry> entries;
+		size_t allocatedBytes;
+
+		//The mapped table file if the table was loaded from a file (the buckets are in it), otherwise nullptr.
+		void* fileMapping;
 
-		unsigned int tt_lookup_count;
+		//Size of the mapped table file.
+		size_t fileMappingBytes;
 
-		unsigned int tt_put_count;
+		//Counter of the searches, wraps around at 64. Stored into the entries to know their age.
+		unsigned char generation;
 
 	public:
 		/*
-		 * Create an "empty" transposition table. It will have all entries set to EMPTY_ENTRY.
+		 * Create an empty transposition table of the given size in megabytes. It is
+		 * cleared using the given amount of threads. If allocate is false, the memory is not allocated
+		 * yet, and load or resize must be called before the table is used: a table that is going to be
+		 * loaded from a file is not allocated and cleared for nothing.
+		 */
+		transposition_table(unsigned int megabytes, unsigned int threads = 1, bool allocate = true);
+
+		~transposition_table();
+
+		//The table is large, it is never copied.
+		transposition_table(const transposition_table&) = delete;
+
+		transposition_table& operator=(const transposition_table&) = delete;
+
+		/*
+		 * Changes the size of the table to the given megabytes, the table will be empty. The
+		 * table object stays the same, so the searches referencing it can continue to use it.
+		 */
+		void resize(unsigned int megabytes, unsigned int threads = 1);
+
+		/*
+		 * Writes the table into a file: a header describing the entry layout, the size and the hash keys, then
+		 * the buckets as they are in the memory. Throws runtime_error if the file can't be written. Must not be
+		 * called during a search.
+		 */
+		void save(const std::string& path) const;
+
+		/*
+		 * Loads a table saved by save. The file is mapped into the memory privately: the entries are not
+		 * read or parsed, the pages are loaded when the search first touches them, and changes are not written
+		 * back to the file. The table takes the size of the saved table. Returns false (and the table is
+		 * unchanged) if the file does not exist or was saved with a different entry layout or hash keys.
+		 * Throws runtime_error if the file can't be mapped. Must not be called during a search.
 		 */
-		transposition_table(unsigned int size) : size(size), entries(size, EMPTY_ENTRY), tt_lookup_count(0), tt_put_count(0) {}
+		bool load(const std::string& path);
 
 		/*
-		 * Returns the entry for the given key. First the index of the key
-		 * is created using the modulo operator.
-		 * To see if there is an actual entry, the result must be compared with
-		 * Value::EMPTY_ENTRY.
+		 * Empties the table, for example before a new game. The buckets are split between the
+		 * given amount of threads. Must not be called during a search.
 		 */
-		transposition_entry& find(uint64 key) {
-			++tt_lookup_count;
-			return entries[key % size];
+		void clear(unsigned int threads = 1);
+
+		//Size of the table in megabytes.
+		unsigned int megabytes() const {
+			return (unsigned int)(((unsigned long long)size * sizeof(tt_bucket)) >> 20);
 		}
 
 		/*
-		 * Adds a new entry to the table, according to the replacement
-		 * strategy.
+		 * Looks for the entry of the key. If it is found, then it is copied into
+		 * the entry parameter and true is returned. Ply is the distance of the position from the root.
+		 */
+		bool find(uint64 key, transposition_entry& entry, unsigned int ply) const;
+
+		/*
+		 * Adds a new entry to the table. If the position already has an entry, then it is replaced according
+		 * to the replacement strategy, otherwise the empty, or the least valuable slot of the bucket is used.
+		 * Ply is the distance of the position from the root. Returns true if an entry of another position, stored
+		 * in the current search, was replaced (a collision).
+		 */
+		bool put(uint64 key, const transposition_entry& entry, unsigned int ply);
+
+		/*
+		 * Starts loading the bucket of the key into the cache without waiting for it. Called as soon as the
+		 * key of a child node is known, so that the memory access overlaps with the work before its probe.
 		 */
-		void put(uint64 key, transposition_entry entry) {
-			auto mod = key % size;
-			if(replaceOldEntry(entries[mod], entry)) {
-				++tt_put_count;
-				//replace the old entry
-				entries[mod] = entry;
-			}
+		inline void prefetch(uint64 key) const {
+#if defined(__GNUC__) || defined(__clang__)
+			__builtin_prefetch(&buckets[bucketIndex(key)]);
+#endif
 		}
 
 		/*
-		 * Marks all entries as "useless". This is called between each move search, to
-		 * allow the replacement of old entries.
+		 * Called before each search: the entries of earlier searches get one generation older, so
+		 * they are replaced more easily. Doesn't touch the entries.
 		 */
-		void invalidateEntries() {
-			for(unsigned int i = 0; i < size; ++i) {
-				entries[i].usefulEntry = false;
-			}
+		void newSearch() {
+			generation = (generation + 1) & 63;
 		}
 
+		/*
+		 * The ratio of slots used by the current search, estimated from the first few thousand slots.
+		 */
+		double occupancy() const;
+
 		void printDebug() const {
-			std::cout << "TT lookup used: " << tt_lookup_count << "\n" <<
-					"TT put used: " << tt_put_count << std::endl;
+			std::cout << "TT occupancy: " << occupancy() * 100 << "%" << std::endl;
 		}
 
 	private:
 
+		//Frees the buckets, allocated or mapped from a file.
+		void release();
+
+		/*
+		 * Maps the key to a bucket index in [0, size) without division: the high 64 bits of the 128 bit
+		 * product key * size (the "fastrange" method). Any table size can be used this way, and the
+		 * index depends mostly on the upper bits of the key.
+		 */
+		inline unsigned int bucketIndex(uint64 key) const {
+#ifdef __SIZEOF_INT128__
+			return (unsigned int)(((unsigned __int128)key * size) >> 64);
+#else
+			//size fits in 32 bits: key * size = (high * 2^32 + low) * size
+			uint64 high = key >> 32, low = key & 0xFFFFFFFFULL;
+			return (unsigned int)((high * size + ((low * size) >> 32)) >> 32);
+#endif
+		}
+
+		/*
+		 * How valuable the stored entry is, the least valuable one is replaced. Deeper entries are worth
+		 * more, and an exact entry is worth a bit more than a bound of the same depth. Old entries
+		 * lose 2 plies of value for each search since they were stored.
+		 */
+		inline int entryValue(const packed_entry& entry) const {
+			int age = (generation - entry.getGeneration()) & 63; //wraps around correctly
+			return (int)entry.depth - 2 * age + (entry.getEntryType() == exact ? 1 : 0);
+		}
+
 		/*
-		 * This function determines the replacement strategy of the transposition table.
+		 * This function determines the replacement strategy of the transposition table, when the same
+		 * position is stored again.
 		 */
-		inline bool replaceOldEntry(transposition_entry oldEntry, transposition_entry newEntry) {
-			if(oldEntry.entryType == exact && newEntry.entryType != exact) return false; //never replace exact with not exact
-			if(oldEntry.entryType != exact && newEntry.entryType == exact) return true; //always replace not exact with exact
-			return !oldEntry.usefulEntry; //if the old entry was used in lookup recently, then dont replace
+		inline bool replaceOldEntry(const packed_entry& oldEntry, const transposition_entry& newEntry) const {
+			int newValue = (int)newEntry.depth + (newEntry.entryType == exact ? 1 : 0);
+			return newValue >= entryValue(oldEntry);
 		}
 	};
 }
@@ -21,6 +21,7 @@ namespace tchess
 					  << "Select who will play " << sideName << ":" << std::endl
 					  << " - Type p for player!" << std::endl
 					  << " - Type e for engine!" << std::endl
+					  << " - Type o for engine that also thinks on the opponent's time (pondering)!" << std::endl
 					  << " - Type r for the random move maker!" << std::endl
 					  << " - Type g for the greedy move maker!" << std::endl;
 
@@ -31,6 +32,9 @@ namespace tchess
 			} else if(selection == "e") {
 				std::cout << sideName << " will be controlled by the TChess engine." << std::endl;
 				selected = true;
+			} else if(selection == "o") {
+				std::cout << sideName << " will be controlled by the TChess engine, with pondering." << std::endl;
+				selected = true;
 			} else if(selection == "r") {
 				std::cout << sideName << " will be controlled by the Random move maker." << std::endl;
 				selected = true;
@@ -49,10 +53,14 @@ namespace tchess
 		char blackSelect = selectPlayerForSide("Black");
 		player* whitePlayer = nullptr;
 		player* blackPlayer = nullptr;
+		search_options ponderOptions;
+		ponderOptions.ponder = true;
 		if(whiteSelect == 'p') {
 			whitePlayer = new human_player_console(white);
 		} else if(whiteSelect == 'e') {
 			whitePlayer = new engine(white);
+		} else if(whiteSelect == 'o') {
+			whitePlayer = new engine(white, default_depth, ponderOptions);
 		} else if(whiteSelect == 'r') {
 			whitePlayer = new random_player(white);
 		} else if(whiteSelect == 'g') {
@@ -62,6 +70,8 @@ namespace tchess
 			blackPlayer = new human_player_console(black);
 		} else if(blackSelect == 'e') {
 			blackPlayer = new engine(black);
+		} else if(blackSelect == 'o') {
+			blackPlayer = new engine(black, default_depth, ponderOptions);
 		} else if(blackSelect == 'r') {
 			blackPlayer = new random_player(black);
 		} else if(blackSelect == 'g') {
@@ -79,6 +89,7 @@ namespace tchess
 	bool game::playGame() {
 		std::cout << "The game begins: " << whitePlayer->description() << " vs " << blackPlayer->description() << std::endl;
 		std::cout << board.to_string();
+		history.push(createZobrishHash(board, info)); //starting position
 		while(!gameEnded) { //the endGame method will set this to true
 			acceptMove();
 		}
@@ -164,6 +175,10 @@ namespace tchess
 					stalemate = true;
 				}
 			}
+			//check for repetition: the position must have occurred 2 times before
+			uint64 positionKey = createZobrishHash(board, info);
+			bool threefoldRepetition = history.isRepeated(positionKey, info.getHalfmoveClock(), 2);
+			history.push(positionKey);
 			std::cout << "Move " << moves.size() << ": " << playerWhoMoves <<
 					" has made the move: " << m.to_string(pieceThatMoved);
 			if(checkmate) {
@@ -178,6 +193,14 @@ namespace tchess
 				std::cout << std::endl;
 				startNewGame = endGame(true, "", "Insufficient mating material");
 				return;
+			} else if(threefoldRepetition) {
+				std::cout << std::endl;
+				startNewGame = endGame(true, "", "Threefold repetition");
+				return;
+			} else if(info.getHalfmoveClock() >= 100) { //50 moves by both sides
+				std::cout << std::endl;
+				startNewGame = endGame(true, "", "Fifty-move rule");
+				return;
 			} else if(check) {
 				std::cout << " (check)";
 			}
@@ -203,6 +226,10 @@ namespace tchess
 		return moves;
 	}
 
+	const position_history& game::getPositionHistory() const {
+		return history;
+	}
+
 	move_legality_result game::isValidMove(const move& playerMove, std::vector<move>& pseudoLegalMoves) {
 		bool legal = false;
 		bool pseudoLegal = false;
@@ -16,6 +16,7 @@
 #include "board/board.h"
 #include "board/move.h"
 #include "player.h"
+#include "board/position_history.h"
 
 namespace tchess
 {
@@ -75,6 +76,11 @@ namespace tchess
 		 */
 		std::vector<move> moves;
 
+		/*
+		 * Hash keys of all positions of the game, used to detect threefold repetition.
+		 */
+		position_history history;
+
 		/*
 		 * Stores how many illegal moves can be submitted by the players before they
 		 * automatically lose the match. By default this is 5.
@@ -103,6 +109,12 @@ namespace tchess
 		 */
 		const std::vector<move>& getMoves() const;
 
+		/*
+		 * Gets the hash keys of the positions of the game, the last one is the current position. Used by
+		 * the engine to detect repetitions during search.
+		 */
+		const position_history& getPositionHistory() const;
+
 	private:
 		/**
 		 * This method asks the player agent whose turn it is to move to submit a move.
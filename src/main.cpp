@@ -1,5 +1,10 @@
+#include <atomic>
 #include <iostream>
 #include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <utility>
 
 #include "board/board.h"
 #include "human/human_player.h"
@@ -17,6 +22,7 @@
 #include "board/evaluation.h"
 
 #include "engine/polyglot.h"
+#include "engine/engine.h"
 
 namespace tchess {
 
@@ -31,10 +37,200 @@ namespace tchess {
 			 4,  2,  3,  6,  5,  3,  2,  4
 	};
 
+	//A middlegame position with a lot of possible exchanges, white to move.
+	const int exchange_test_squares[64] = {
+			-4,  0,  0,  0, -5,  0,  0, -4,
+			-1,  0, -1, -1, -6, -1, -3,  0,
+			-3, -2,  0,  0, -1, -2, -1,  0,
+			 0,  0,  0,  1,  2,  0,  0,  0,
+			 0, -1,  0,  0,  1,  0,  0,  0,
+			 0,  0,  2,  0,  0,  6,  0, -1,
+			 1,  1,  1,  3,  3,  1,  1,  1,
+			 4,  0,  0,  0,  5,  0,  0,  4
+	};
+
+	/*
+	 * Prints the static exchange evaluation of every capture in the exchange test position,
+	 * then measures how long one evaluation takes.
+	 */
+	void benchmarkStaticExchange() {
+		chessboard board(exchange_test_squares);
+		game_information info;
+		move_generator generator(board, info);
+		std::vector<move> moves, captures;
+		generator.generatePseudoLegalMoves(white, moves);
+		for(const move& m: moves) {
+			if(m.isCapture()) {
+				captures.push_back(m);
+				std::cout << m.to_string(std::abs(board[m.getFromSquare()])) << ": "
+						<< staticExchangeEvaluation(board, m) << std::endl;
+			}
+		}
+		const unsigned int rounds = 200000;
+		long long checksum = 0; //so that the calls are not optimized away
+		auto start = std::chrono::steady_clock::now();
+		for(unsigned int i=0; i<rounds; ++i) {
+			for(const move& m: captures) {
+				checksum += staticExchangeEvaluation(board, m);
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+		double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count();
+		std::cout << "Static exchange evaluation: " << nanoseconds / (rounds * captures.size())
+				<< " ns per call (checksum: " << checksum << ")" << std::endl;
+	}
+
+	//Simple xorshift random generator for the benchmarks, reproducible.
+	static uint64 nextRandom(uint64& state) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	/*
+	 * Measures the average time of transposition table lookups, in a small table that fits into
+	 * the cache and in the default size table. Half of the looked up keys are in the table. The
+	 * best of 5 runs is printed.
+	 */
+	void benchmarkTranspositionTable() {
+		const unsigned int sizes[2] = {1, def_hash_size}; //in megabytes
+		const unsigned int keyCount = 1 << 22;
+		for(unsigned int megabytes: sizes) {
+			auto allocationStart = std::chrono::steady_clock::now();
+			transposition_table table(megabytes, std::thread::hardware_concurrency());
+			std::cout << "Allocated and cleared in " << std::chrono::duration<double, std::milli>(
+					std::chrono::steady_clock::now() - allocationStart).count() << " ms" << std::endl;
+			uint64 state = 88172645463325252ULL;
+			for(unsigned int i=0; i<keyCount; i+=2) { //stored keys: every second key of the sequence
+				uint64 key = nextRandom(state);
+				table.put(key, transposition_entry(key, exact, 1, 0, no_static_evaluation, NULLMOVE), 0);
+				nextRandom(state);
+			}
+			double best = 0;
+			unsigned int hits = 0;
+			transposition_entry entry;
+			for(unsigned int run=0; run<5; ++run) {
+				state = 88172645463325252ULL; //the same sequence again
+				hits = 0;
+				auto start = std::chrono::steady_clock::now();
+				for(unsigned int i=0; i<keyCount; ++i) {
+					if(table.find(nextRandom(state), entry, 0)) ++hits;
+				}
+				auto end = std::chrono::steady_clock::now();
+				double nanoseconds = std::chrono::duration<double, std::nano>(end - start).count() / keyCount;
+				if(run == 0 || nanoseconds < best) best = nanoseconds;
+			}
+			std::cout << "Transposition table of " << table.megabytes() << " MB: "
+					<< best << " ns per lookup (hits: " << hits << ")" << std::endl;
+		}
+	}
+
+	/*
+	 * Stress test of the lockless transposition table: threads store and look up the same small set of
+	 * keys in a small table at the same time, so the slots are overwritten all the time. The stored entries
+	 * are computed from their keys, so every hit can be checked: a torn entry that was accepted is a
+	 * corrupted hit. Should be run with a thread sanitizer build as well, which reports any data race:
+	 *
+	 * g++ -std=c++17 -O1 -g -fsanitize=thread -pthread -I src $(find src -name '*.cpp') -o tchess_tsan
+	 */
+	void stressTranspositionTable() {
+		const unsigned int threads = 8;
+		const unsigned int operations = 200000; //per thread, half stores and half lookups
+		const unsigned int keyCount = 50000;
+		transposition_table table(1);
+		std::atomic<unsigned int> hits(0), corrupted(0);
+		auto stress = [&](unsigned int index) {
+			uint64 state = 0x9E3779B97F4A7C15ULL * (index + 1);
+			transposition_entry entry;
+			for(unsigned int i=0; i<operations; ++i) {
+				uint64 key = (nextRandom(state) % keyCount) * 0x9E3779B97F4A7C15ULL;
+				int score = (int)((key >> 40) % 2000) - 1000;
+				unsigned int depth = (unsigned int)((key >> 20) % 50);
+				if(i % 2 == 0) {
+					table.put(key, transposition_entry(key, exact, depth, score, score / 2, NULLMOVE), 0);
+				} else if(table.find(key, entry, 0)) {
+					++hits;
+					if(entry.score != score || entry.depth != depth || entry.staticEvaluation != score / 2) ++corrupted;
+				}
+			}
+		};
+		std::vector<std::thread> stressThreads;
+		for(unsigned int t=1; t<threads; ++t) {
+			stressThreads.emplace_back(stress, t);
+		}
+		stress(0);
+		for(std::thread& thread: stressThreads) {
+			thread.join();
+		}
+		std::cout << "Transposition table stress test on " << threads << " threads: " << hits
+				<< " hits, " << corrupted << " corrupted" << std::endl;
+	}
+
+	/*
+	 * Multi-PV analysis of the exchange test position: prints the 3 best moves of white,
+	 * searched on 2 threads.
+	 */
+	void analyzeExchangePosition() {
+		chessboard board(exchange_test_squares);
+		game_information info;
+		search_options options;
+		options.threads = 2;
+		engine analyzer(white, default_depth, options);
+		std::vector<root_move_result> results = analyzer.analyze(board, info, 3);
+		for(const root_move_result& result: results) {
+			std::cout << result.rootMove.to_string(std::abs(board[result.rootMove.getFromSquare()])) << ": ";
+			if(result.pv.empty()) { //the analysis was stopped before this move was searched
+				std::cout << "not searched" << std::endl;
+			} else {
+				std::cout << result.score << std::endl;
+			}
+		}
+	}
+
+	/*
+	 * Measures how long a book lookup takes: the positions of a book line from the starting
+	 * position (as long as the book has moves), and a position that is not in the book.
+	 */
+	void benchmarkOpeningBook() {
+		auto loadStart = std::chrono::steady_clock::now();
+		opening_book book;
+		std::cout << "Opening book loaded in " << std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - loadStart).count() << " ms" << std::endl;
+		std::vector<std::pair<chessboard, game_information>> positions;
+		chessboard board(test_squares);
+		game_information info;
+		for(unsigned int ply=0; ply<12; ++ply) {
+			positions.push_back(std::make_pair(board, info));
+			move bookMove = book.getBookMove(board, info);
+			if(bookMove == NULLMOVE) break;
+			board.makeMove(bookMove, info.getSideToMove());
+			updateGameInformation(board, bookMove, info);
+		}
+		positions.push_back(std::make_pair(chessboard(exchange_test_squares), game_information()));
+		const unsigned int rounds = 20000;
+		unsigned int found = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(unsigned int i=0; i<rounds; ++i) {
+			for(auto& position: positions) {
+				if(!(book.getBookMove(position.first, position.second) == NULLMOVE)) ++found;
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+		double microseconds = std::chrono::duration<double, std::micro>(end - start).count();
+		std::cout << "Opening book: " << microseconds / (rounds * positions.size()) << " us per lookup ("
+				<< positions.size() << " positions, found: " << found / rounds << ")" << std::endl;
+	}
+
 	/*
 	 * Can test all kind of functions here.
 	 */
 	void test() {
+		benchmarkStaticExchange();
+		benchmarkTranspositionTable();
+		stressTranspositionTable();
+		benchmarkOpeningBook();
+		analyzeExchangePosition();
 	}
 }
 